@@ -0,0 +1,40 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+void* arena_push(Arena& arena, u64 size, u64 align) {
+  ASSERT(align <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "arena blocks arent aligned enough");
+
+  while (true) {
+    if (arena.block_idx < arena.blocks.size()) {
+      auto& block = arena.blocks[arena.block_idx];
+      u64 offset  = (arena.used + align - 1) & ~(align - 1);
+      if (offset + size <= block.size) {
+        arena.used = offset + size;
+        return block.memory.get() + offset;
+      }
+      ++arena.block_idx;
+      arena.used = 0;
+      continue;
+    }
+
+    u64 block_size = std::max(ARENA_BLOCK_SIZE, size);
+    arena.blocks.push_back({
+      .memory = std::make_unique_for_overwrite<std::byte[]>(block_size),
+      .size   = block_size,
+    });
+  }
+}
+
+void arena_reset(Arena& arena) {
+  arena.block_idx = 0;
+  arena.used      = 0;
+}
+
+const char* arena_push_string(Arena& arena, std::string_view string) {
+  auto* memory = static_cast<char*>(arena_push(arena, string.size() + 1, alignof(char)));
+  std::memcpy(memory, string.data(), string.size());
+  memory[string.size()] = '\0';
+  return memory;
+}
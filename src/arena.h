@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "core.h"
+
+static constexpr u64 ARENA_BLOCK_SIZE = 64 * 1024;
+
+struct ArenaBlock {
+  std::unique_ptr<std::byte[]> memory{};
+  u64 size{};
+};
+
+// NOTE: bump allocator, everything on it gets freed at once by arena_reset()
+// the blocks stick around after a reset, so once it grew big enough it never allocates again
+struct Arena {
+  std::vector<ArenaBlock> blocks{};
+  u32 block_idx{};
+  u64 used{};
+};
+
+void* arena_push(Arena& arena, u64 size, u64 align);
+void arena_reset(Arena& arena);
+
+// NOTE: arena_reset() doesnt call any destructors, that is on the user
+template <typename T, typename... Args>
+T* arena_new(Arena& arena, Args&&... args) {
+  void* memory = arena_push(arena, sizeof(T), alignof(T));
+  return new (memory) T(std::forward<Args>(args)...);
+}
+
+// NOTE: copies the string onto the arena, with a null terminator (for raylib)
+const char* arena_push_string(Arena& arena, std::string_view string);
+
+// NOTE: growable array on an arena, growing copies it over to a new spot on the arena
+// and the old one just stays there until the reset
+template <typename T>
+struct ArenaArray {
+  static_assert(std::is_trivially_copyable_v<T>, "nothing on an arena gets destroyed");
+
+  T* data{};
+  u32 count{};
+  u32 capacity{};
+
+  u32 size() const {
+    return count;
+  }
+
+  T& operator[](u32 idx) {
+    return data[idx];
+  }
+
+  const T& operator[](u32 idx) const {
+    return data[idx];
+  }
+
+  T* begin() const {
+    return data;
+  }
+
+  T* end() const {
+    return data + count;
+  }
+};
+
+template <typename T>
+T& arena_push_back(Arena& arena, ArenaArray<T>& array, const T& value) {
+  if (array.count == array.capacity) {
+    u32 capacity = array.capacity ? array.capacity * 2 : 64;
+    T* data      = static_cast<T*>(arena_push(arena, u64(capacity) * sizeof(T), alignof(T)));
+    if (array.count > 0) {
+      std::memcpy(data, array.data, u64(array.count) * sizeof(T));
+    }
+    array.data     = data;
+    array.capacity = capacity;
+  }
+  array.data[array.count] = value;
+  return array.data[array.count++];
+}
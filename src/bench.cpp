@@ -0,0 +1,669 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json.hpp"
+
+#include "core.h"
+#include "utils.h"
+#include "game.h"
+#include "entity.h"
+#include "systems.h"
+#include "jobs.h"
+#include "ui.h"
+#include "serialization.h"
+#include "simulation.h"
+
+using json = nlohmann::json;
+
+// NOTE: builds a synthetic factory and times every system on it, without a window
+// the results go to stdout (or --output) as json or csv, the progress goes to stderr
+// usage: game_bench [--preset small|large] [--lines N] [--line-length L] [--assemblers M]
+//                   [--tunnels K] [--items P] [--iterations I] [--threads 1,2,4,8]
+//                   [--filter name] [--format json|csv] [--output file]
+// there is no font without a window, so ui text measures as zero wide
+
+struct BenchFixture {
+  // NOTE: every line is a loop, so its items keep moving no matter how many ticks run
+  u32 lines{};
+  u32 line_length{};
+  // NOTE: storage -> conveyor -> assembler -> conveyor -> storage
+  u32 assemblers{};
+  u32 tunnel_pairs{};
+  u32 dropped_items{};
+};
+
+static constexpr BenchFixture BENCH_FIXTURE_SMALL = {
+  .lines         = 10,
+  .line_length   = 20,
+  .assemblers    = 10,
+  .tunnel_pairs  = 2,
+  .dropped_items = 100,
+};
+
+// NOTE: 100k conveyors
+static constexpr BenchFixture BENCH_FIXTURE_LARGE = {
+  .lines         = 1000,
+  .line_length   = 100,
+  .assemblers    = 1000,
+  .tunnel_pairs  = 16,
+  .dropped_items = 10000,
+};
+
+struct BenchOptions {
+  BenchFixture fixture = BENCH_FIXTURE_LARGE;
+  u32 iterations       = 100;
+  std::vector<u32> thread_counts = {1, 2, 4, 8};
+  std::string_view filter{};
+  bool csv{};
+  std::string_view output_filepath{};
+};
+
+struct BenchResult {
+  std::string name{};
+  u32 threads{};
+  u32 iterations{};
+  u32 ops_per_iteration{};
+  // NOTE: per op
+  f64 mean_ns{};
+  f64 median_ns{};
+  f64 min_ns{};
+  f64 max_ns{};
+};
+
+struct Bench {
+  const BenchOptions* options{};
+  u32 threads = 1;
+  std::vector<BenchResult> results{};
+};
+
+static constexpr u64 BENCH_RANDOM_SEED = 0x6265'6e63'6873'6565;
+static constexpr u32 BENCH_LOOKUPS     = 1024;
+static constexpr u32 BENCH_CHURN       = 1024;
+static constexpr u32 BENCH_ROW_WIDTH   = 128;
+
+// NOTE: keeps the compiler from throwing away lookups whose result is never used
+static volatile u64 bench_sink = 0;
+
+// NOTE: setup runs before every iteration and isnt part of the time,
+// run does ops_per_iteration of whatever is measured
+static void bench_run(
+  Bench& bench,
+  std::string_view name,
+  u32 iterations,
+  u32 ops_per_iteration,
+  const std::function<void()>& setup,
+  const std::function<void()>& run
+) {
+  if (!bench.options->filter.empty() && !name.contains(bench.options->filter)) {
+    return;
+  }
+
+  // NOTE: warms up the caches and whatever gets allocated lazily
+  setup();
+  run();
+
+  std::vector<f64> samples(iterations);
+  for (auto& sample : samples) {
+    setup();
+    auto start = std::chrono::steady_clock::now();
+    run();
+    auto end = std::chrono::steady_clock::now();
+    sample   = std::chrono::duration<f64, std::nano>(end - start).count() / ops_per_iteration;
+  }
+
+  std::ranges::sort(samples);
+  f64 total{};
+  for (auto sample : samples) {
+    total += sample;
+  }
+  BenchResult result = {
+    .name              = std::string(name),
+    .threads           = bench.threads,
+    .iterations        = iterations,
+    .ops_per_iteration = ops_per_iteration,
+    .mean_ns           = total / iterations,
+    .median_ns         = samples[iterations / 2],
+    .min_ns            = samples.front(),
+    .max_ns            = samples.back(),
+  };
+  std::println(
+    stderr,
+    "{:<36} {} thread(s): {:>14.1f} ns/op (median {:.1f})",
+    result.name,
+    result.threads,
+    result.mean_ns,
+    result.median_ns
+  );
+  bench.results.push_back(std::move(result));
+}
+
+static void bench_run(
+  Bench& bench,
+  std::string_view name,
+  u32 iterations,
+  u32 ops_per_iteration,
+  const std::function<void()>& run
+) {
+  bench_run(bench, name, iterations, ops_per_iteration, [] {}, run);
+}
+
+static EntityId bench_add(State& state, const vec2& pos, World world, const EntityData& data) {
+  return add_entity(state.store, {.pos = pos, .world = world, .data = data});
+}
+
+// NOTE: a 2 tall loop, going right along the top and left along the bottom
+static void bench_add_conveyor_loop(State& state, const vec2& pos, u32 length) {
+  u32 width = std::max(length / 2, 2u);
+
+  std::vector<std::pair<vec2, Direction>> tiles{};
+  for (u32 x = 0; x < width; ++x) {
+    tiles.push_back({pos + vec2{f32(x), 0}, x + 1 < width ? DIR_RIGHT : DIR_DOWN});
+  }
+  for (u32 x = width; x-- > 0;) {
+    tiles.push_back({pos + vec2{f32(x), 1}, x > 0 ? DIR_LEFT : DIR_UP});
+  }
+
+  for (u32 i = 0; i < tiles.size(); ++i) {
+    auto& [tile_pos, to] = tiles[i];
+    Conveyor conveyor{};
+    conveyor.to       = to;
+    conveyor.rotation = opposite_direction(tiles[(i + tiles.size() - 1) % tiles.size()].second);
+    if (i % 2 == 0) {
+      conveyor.items[0] = {.slot = {.type = ITEM_COGWHEEL, .count = 1}, .t = 0.5f};
+    }
+    bench_add(state, tile_pos, WORLD_MAIN, conveyor);
+  }
+}
+
+static void bench_add_assembler_unit(State& state, const vec2& pos) {
+  auto max_count = item_info(ITEM_ALUMINIUM).max_count;
+  Storage source{};
+  for (auto& slot : source.inventory) {
+    slot.type  = ITEM_ALUMINIUM;
+    slot.count = max_count;
+  }
+  Conveyor input{};
+  input.to       = DIR_RIGHT;
+  input.rotation = DIR_LEFT;
+  // NOTE: the first recipe only needs aluminium
+  Assembler assembler{};
+  assembler.selected_recipe_idx = 0;
+  Conveyor output               = input;
+
+  bench_add(state, pos, WORLD_MAIN, source);
+  bench_add(state, pos + vec2{1, 0}, WORLD_MAIN, input);
+  bench_add(state, pos + vec2{2, 0}, WORLD_MAIN, assembler);
+  bench_add(state, pos + vec2{3, 0}, WORLD_MAIN, output);
+  bench_add(state, pos + vec2{4, 0}, WORLD_MAIN, Storage{});
+}
+
+// NOTE: the lines take up x >= 0 and y >= 0, the assemblers x >= 0 and y < 0,
+// the tunnels x < 0 and y >= 0 and the dropped items x < 0 and y < 0
+static void bench_build_fixture(State& state, const BenchFixture& fixture) {
+  state.random_seed = BENCH_RANDOM_SEED;
+  state.player_id   = bench_add(state, {-5, -5}, WORLD_MAIN, Player{});
+  state.resource_message_receiver_id =
+    bench_add(state, {-20, -8}, WORLD_MAIN, ResourceMessageReceiver{});
+
+  for (u32 i = 0; i < fixture.lines; ++i) {
+    bench_add_conveyor_loop(state, {0, f32(i * 3)}, fixture.line_length);
+  }
+
+  for (u32 i = 0; i < fixture.assemblers; ++i) {
+    vec2 pos = {f32(i % BENCH_ROW_WIDTH) * 6, -4 - f32(i / BENCH_ROW_WIDTH) * 2};
+    bench_add_assembler_unit(state, pos);
+  }
+
+  // NOTE: every tunnel of a pair of worlds leads to the first one in the other world
+  for (u32 i = 0; i < fixture.tunnel_pairs; ++i) {
+    vec2 pos = {-10 - f32(i % BENCH_ROW_WIDTH) * 2, f32(i / BENCH_ROW_WIDTH) * 2};
+    WorldTunnel from{};
+    from.to                 = WORLD_STORAGE;
+    from.inventory[0].type  = ITEM_COPPER;
+    from.inventory[0].count = item_info(ITEM_COPPER).max_count;
+    WorldTunnel to{};
+    to.to = WORLD_MAIN;
+
+    bench_add(state, pos, WORLD_MAIN, from);
+    bench_add(state, pos, WORLD_STORAGE, to);
+  }
+
+  for (u32 i = 0; i < fixture.dropped_items; ++i) {
+    vec2 pos = {-30 - f32(i % BENCH_ROW_WIDTH), -10 - f32(i / BENCH_ROW_WIDTH)};
+    bench_add(state, pos, WORLD_MAIN, Item{.slot = {.type = ITEM_COPPER, .count = 1}});
+  }
+
+  flush(state.store);
+}
+
+// NOTE: roughly what an open inventory looks like, a grid of slots with a count in every one
+static UI_Layout bench_build_ui_layout(UI_System& system, const Input& input) {
+  static constexpr u32 ROWS    = 16;
+  static constexpr u32 COLUMNS = 16;
+
+  auto layout = ui_layout_begin("bench", system, input, {}, {1920, 1080});
+  ui_element_begin(layout, UI_AUTO_ID);
+  for (u32 row = 0; row < ROWS; ++row) {
+    ui_element_begin(layout, UI_AUTO_ID);
+    for (u32 column = 0; column < COLUMNS; ++column) {
+      ui_element_begin(layout, UI_AUTO_ID);
+      ui_text(layout, "64", 20);
+      ui_element_end(
+        layout,
+        {
+          .sizing   = {ui_sizing_fixed(48), ui_sizing_fixed(48)},
+          .padding  = ui_padding_all(4),
+          .bg_color = GRAY,
+        }
+      );
+    }
+    ui_element_end(
+      layout,
+      {.layout_direction = UI_LAYOUT_DIRECTION_HORIZONTAL, .child_gap = 4}
+    );
+  }
+  ui_element_end(
+    layout,
+    {
+      .layout_direction = UI_LAYOUT_DIRECTION_VERTICAL,
+      .padding          = ui_padding_all(8),
+      .child_gap        = 4,
+    }
+  );
+  return layout;
+}
+
+static void bench_systems(Bench& bench, State& state) {
+  u32 iterations = bench.options->iterations;
+  auto& store    = state.store;
+
+  bench_run(bench, "system_update_time", iterations, 1, [&] {
+    system_update_time(state.minutes, state.minutes_accumulator, DT);
+  });
+  bench_run(bench, "system_move_player", iterations, 1, [&] {
+    system_move_player(store, state.player_id, state.tick_input, DT);
+  });
+  bench_run(bench, "system_open_gui", iterations, 1, [&] {
+    system_open_gui(store, state.player_id, state.tick_input, state.frame.mouse_world_pos);
+  });
+  bench_run(bench, "system_close_gui", iterations, 1, [&] {
+    system_close_gui(store, state.player_id, state.tick_input);
+  });
+  bench_run(bench, "system_hand_slot_interactions", iterations, 1, [&] {
+    system_hand_slot_interactions(
+      store,
+      state.player_id,
+      state.frame.hovered_slot,
+      state.tick_input
+    );
+  });
+  bench_run(bench, "system_drop_items", iterations, 1, [&] {
+    system_drop_items(store, state.player_id, state.tick_input, state.frame.mouse_world_pos);
+  });
+  bench_run(bench, "system_transfer_resource_messages", iterations, 1, [&] {
+    system_transfer_resource_messages(
+      store,
+      state.resource_message_receiver_id,
+      state.resource_message_queue,
+      state.minutes
+    );
+  });
+  bench_run(bench, "system_progress_recipes", iterations, 1, [&] {
+    for (u32 world = 0; world < WORLD_COUNT; ++world) {
+      system_progress_recipes(store, World(world), DT);
+    }
+  });
+  bench_run(bench, "system_place_entity", iterations, 1, [&] {
+    system_place_entity(
+      store,
+      state.player_id,
+      state.tick_input,
+      state.frame.mouse_world_pos,
+      state.current_place_rotation
+    );
+  });
+  bench_run(bench, "system_remove_entity", iterations, 1, [&] {
+    system_remove_entity(store, state.player_id, state.tick_input, state.frame.mouse_world_pos);
+  });
+  bench_run(bench, "system_pickup_item", iterations, 1, [&] {
+    system_pickup_item(store, state.player_id);
+  });
+  update_conveyor_graph(store);
+  bench_run(bench, "system_output_items", iterations, 1, [&] {
+    for (u32 world = 0; world < WORLD_COUNT; ++world) {
+      system_output_items(store, World(world), DT);
+    }
+  });
+  bench_run(bench, "system_tunnel_through_worlds", iterations, 1, [&] {
+    system_tunnel_through_worlds(store, state.player_id);
+  });
+  u64 tick = 0;
+  bench_run(bench, "system_apply_maintenance", iterations, 1, [&] {
+    system_apply_maintenance(store, state.random_seed, tick++);
+  });
+  bench_run(bench, "system_update_maintenance_minigames", iterations, 1, [&] {
+    system_update_maintenance_minigames(store, state.tick_input, DT);
+  });
+  bench_run(bench, "system_update_camera", iterations, 1, [&] {
+    system_update_camera(state.camera, state.tick_input, store, state.player_id, {1920, 1080});
+  });
+
+  // NOTE: the systems above queue commands and events, which a tick would clear
+  flush(store);
+  clear_event_bus(store);
+}
+
+// NOTE: the parts that run on the job system, timed once for every thread count
+static void bench_threaded(Bench& bench, State& state) {
+  u32 iterations = bench.options->iterations;
+  auto& store    = state.store;
+
+  update_conveyor_graph(store);
+  bench_run(bench, "system_move_items", iterations, 1, [&] {
+    for (u32 world = 0; world < WORLD_COUNT; ++world) {
+      system_move_items(store, World(world), DT);
+    }
+  });
+  bench_run(bench, "simulation_tick", iterations, 1, [&] { simulation_tick(state, DT); });
+}
+
+static void bench_store(Bench& bench, State& state) {
+  u32 iterations = bench.options->iterations;
+  auto& store    = state.store;
+
+  std::vector<EntityId> churn(BENCH_CHURN);
+  bench_run(bench, "flush_add_remove", iterations, BENCH_CHURN * 2, [&] {
+    for (u32 i = 0; i < BENCH_CHURN; ++i) {
+      vec2 pos = {-1000 - f32(i % BENCH_ROW_WIDTH), -1000 - f32(i / BENCH_ROW_WIDTH)};
+      churn[i] = bench_add(state, pos, WORLD_MAIN, Item{.slot = {.type = ITEM_COPPER, .count = 1}});
+    }
+    flush(store);
+    for (auto id : churn) {
+      remove_entity(store, id);
+    }
+    flush(store);
+  });
+
+  // NOTE: half of the positions hit the conveyor lines, the other half are empty
+  auto random = random_init(BENCH_RANDOM_SEED, 0);
+  f32 width   = std::max(bench.options->fixture.line_length / 2, 2u);
+  f32 height  = bench.options->fixture.lines * 3;
+  std::vector<vec2> positions(BENCH_LOOKUPS);
+  for (auto& pos : positions) {
+    pos = {
+      std::floor(random_get<f32>(random, -width, width)),
+      std::floor(random_get<f32>(random, 0, height)),
+    };
+  }
+  bench_run(bench, "get_entity_at_pos", iterations, BENCH_LOOKUPS, [&] {
+    u64 found{};
+    for (auto& pos : positions) {
+      found += get_entity_at_pos(store, pos, WORLD_MAIN, {1, 1}) != nullptr;
+    }
+    bench_sink = found;
+  });
+
+  std::vector<EntityId> all_ids{};
+  for (auto& entity : store) {
+    all_ids.push_back(entity.id);
+  }
+  std::vector<EntityId> ids(BENCH_LOOKUPS);
+  for (auto& id : ids) {
+    id = all_ids[random_get<u32>(random, 0, all_ids.size() - 1)];
+  }
+  bench_run(bench, "get_entity", iterations, BENCH_LOOKUPS, [&] {
+    u64 found{};
+    for (auto id : ids) {
+      found += get_entity(store, id) != nullptr;
+    }
+    bench_sink = found;
+  });
+  bench_run(bench, "contains_entity", iterations, BENCH_LOOKUPS, [&] {
+    u64 found{};
+    for (auto id : ids) {
+      found += contains_entity(store, id);
+    }
+    bench_sink = found;
+  });
+}
+
+static void bench_serialization(Bench& bench, State& state) {
+  // NOTE: a whole save per iteration is slow at scale, so these run fewer times
+  u32 iterations = std::max(bench.options->iterations / 10, 3u);
+  auto filepath  = std::filesystem::temp_directory_path() / "game_bench_save_file.json";
+
+  bench_run(bench, "save_state_to_file", iterations, 1, [&] {
+    save_state_to_file(state, filepath);
+  });
+
+  State loaded = {};
+  bench_run(bench, "load_state_from_file", iterations, 1, [&] {
+    load_state_from_file(loaded, filepath);
+    flush(loaded.store);
+  });
+
+  std::filesystem::remove(filepath);
+}
+
+static void bench_ui(Bench& bench) {
+  UI_System system{};
+  Input input{};
+  std::optional<UI_Layout> layout{};
+  bench_run(
+    bench,
+    "ui_layout_end",
+    bench.options->iterations,
+    1,
+    [&] {
+      ui_system_update(system);
+      layout = bench_build_ui_layout(system, input);
+    },
+    [&] { ui_layout_end(*layout); }
+  );
+}
+
+static void bench_write_json(const Bench& bench, std::FILE* file) {
+  auto& fixture = bench.options->fixture;
+  json results  = json::array();
+  for (auto& result : bench.results) {
+    results.push_back({
+      {"name", result.name},
+      {"threads", result.threads},
+      {"iterations", result.iterations},
+      {"ops_per_iteration", result.ops_per_iteration},
+      {"mean_ns", result.mean_ns},
+      {"median_ns", result.median_ns},
+      {"min_ns", result.min_ns},
+      {"max_ns", result.max_ns},
+    });
+  }
+  json output = {
+    {"fixture",
+     {
+       {"lines", fixture.lines},
+       {"line_length", fixture.line_length},
+       {"assemblers", fixture.assemblers},
+       {"tunnel_pairs", fixture.tunnel_pairs},
+       {"dropped_items", fixture.dropped_items},
+     }},
+    {"mode_debug", bool(MODE_DEBUG)},
+    {"results", results},
+  };
+  std::println(file, "{}", output.dump(2));
+}
+
+// NOTE: the fixture is repeated on every row, so files from different runs can just be appended
+static void bench_write_csv(const Bench& bench, std::FILE* file) {
+  auto& fixture = bench.options->fixture;
+  std::println(
+    file,
+    "name,threads,iterations,ops_per_iteration,mean_ns,median_ns,min_ns,max_ns,"
+    "lines,line_length,assemblers,tunnel_pairs,dropped_items"
+  );
+  for (auto& result : bench.results) {
+    std::println(
+      file,
+      "{},{},{},{},{:.3f},{:.3f},{:.3f},{:.3f},{},{},{},{},{}",
+      result.name,
+      result.threads,
+      result.iterations,
+      result.ops_per_iteration,
+      result.mean_ns,
+      result.median_ns,
+      result.min_ns,
+      result.max_ns,
+      fixture.lines,
+      fixture.line_length,
+      fixture.assemblers,
+      fixture.tunnel_pairs,
+      fixture.dropped_items
+    );
+  }
+}
+
+static bool parse_u32(std::string_view arg, u32& out) {
+  auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), out);
+  return error == std::errc{} && end == arg.data() + arg.size();
+}
+
+static bool parse_options(i32 argc, char** argv, BenchOptions& options) {
+  for (i32 i = 1; i < argc; ++i) {
+    std::string_view flag = argv[i];
+    if (i + 1 == argc) {
+      std::println(stderr, "'{}' needs a value", flag);
+      return false;
+    }
+    std::string_view value = argv[++i];
+
+    u32* number = nullptr;
+    if (flag == "--lines") {
+      number = &options.fixture.lines;
+    } else if (flag == "--line-length") {
+      number = &options.fixture.line_length;
+    } else if (flag == "--assemblers") {
+      number = &options.fixture.assemblers;
+    } else if (flag == "--tunnels") {
+      number = &options.fixture.tunnel_pairs;
+    } else if (flag == "--items") {
+      number = &options.fixture.dropped_items;
+    } else if (flag == "--iterations") {
+      number = &options.iterations;
+    } else if (flag == "--preset") {
+      if (value == "small") {
+        options.fixture = BENCH_FIXTURE_SMALL;
+      } else if (value == "large") {
+        options.fixture = BENCH_FIXTURE_LARGE;
+      } else {
+        std::println(stderr, "unknown preset '{}'", value);
+        return false;
+      }
+    } else if (flag == "--threads") {
+      options.thread_counts.clear();
+      while (!value.empty()) {
+        auto comma = value.find(',');
+        u32 count{};
+        if (!parse_u32(value.substr(0, comma), count) || count == 0) {
+          std::println(stderr, "invalid thread count in '{}'", argv[i]);
+          return false;
+        }
+        options.thread_counts.push_back(count);
+        value = comma == std::string_view::npos ? std::string_view{} : value.substr(comma + 1);
+      }
+    } else if (flag == "--filter") {
+      options.filter = value;
+    } else if (flag == "--format") {
+      if (value != "json" && value != "csv") {
+        std::println(stderr, "unknown format '{}'", value);
+        return false;
+      }
+      options.csv = value == "csv";
+    } else if (flag == "--output") {
+      options.output_filepath = value;
+    } else {
+      std::println(stderr, "unknown option '{}'", flag);
+      return false;
+    }
+
+    if (number && !parse_u32(value, *number)) {
+      std::println(stderr, "invalid value '{}' for '{}'", value, flag);
+      return false;
+    }
+  }
+
+  if (options.iterations == 0) {
+    std::println(stderr, "--iterations has to be at least 1");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options{};
+  if (!parse_options(argc, argv, options)) {
+    return 1;
+  }
+
+  Bench bench = {.options = &options};
+
+  {
+    State state = {};
+    auto start  = std::chrono::steady_clock::now();
+    bench_build_fixture(state, options.fixture);
+    auto end = std::chrono::steady_clock::now();
+    std::println(
+      stderr,
+      "built a fixture of {} entities in {:.3f}s",
+      entity_store_stats(state.store).live,
+      std::chrono::duration<f64>(end - start).count()
+    );
+
+    bench_systems(bench, state);
+    bench_store(bench, state);
+    bench_serialization(bench, state);
+  }
+
+  // NOTE: every thread count gets a fresh fixture, so they all start from the same state
+  for (auto thread_count : options.thread_counts) {
+    jobs_init(thread_count - 1);
+    bench.threads = thread_count;
+
+    State state = {};
+    bench_build_fixture(state, options.fixture);
+    bench_threaded(bench, state);
+
+    jobs_shutdown();
+  }
+  bench.threads = 1;
+
+  bench_ui(bench);
+
+  std::FILE* file = stdout;
+  if (!options.output_filepath.empty()) {
+    file = std::fopen(std::string(options.output_filepath).c_str(), "w");
+    if (!file) {
+      std::println(stderr, "couldnt open '{}' to write the results to", options.output_filepath);
+      return 1;
+    }
+  }
+  if (options.csv) {
+    bench_write_csv(bench, file);
+  } else {
+    bench_write_json(bench, file);
+  }
+  if (file != stdout) {
+    std::fclose(file);
+    std::println(stderr, "saved results to '{}'", options.output_filepath);
+  }
+
+  return 0;
+}
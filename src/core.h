@@ -19,6 +19,7 @@ using f32 = float;
 using f64 = double;
 
 static constexpr u16 U16_MAX = std::numeric_limits<u16>::max();
+static constexpr u32 U32_MAX = std::numeric_limits<u32>::max();
 static constexpr f32 F32_MAX = std::numeric_limits<f32>::max();
 
 #define ASSERT_NO_MSG(expr)                                                                        \
@@ -3,6 +3,7 @@
 #include "gui.h"
 #include "items.h"
 #include "ui.h"
+#include "render.h"
 
 EditorUpdateResult
 editor_update(Editor& editor, EntityStore& store, const Input& input, const vec2& mouse_world_pos) {
@@ -22,7 +23,7 @@ editor_update(Editor& editor, EntityStore& store, const Input& input, const vec2
     const auto& placeable = PLACEABLE[editor.selected_placeable_idx];
     auto dims             = get_dims(placeable);
     if (!get_entity_at_pos(store, mouse_grid_pos, editor.current_world, dims)) {
-      Entity entity = placeable;
+      EntityPrototype entity = placeable;
       entity.pos    = mouse_grid_pos;
       entity.world  = editor.current_world;
       auto id       = add_entity(store, entity);
@@ -41,7 +42,7 @@ editor_update(Editor& editor, EntityStore& store, const Input& input, const vec2
   return result;
 }
 
-static void conveyor_data_edit_gui(UI_Layout& layout, Entity& entity) {
+static bool conveyor_data_edit_gui(UI_Layout& layout, Entity& entity) {
   auto* conveyor = get_data<Conveyor>(entity);
   ASSERT(conveyor, "entity is not a conveyor");
   bool clicked{};
@@ -60,9 +61,10 @@ static void conveyor_data_edit_gui(UI_Layout& layout, Entity& entity) {
   if (clicked) {
     conveyor->to = next_direction(conveyor->to);
   }
+  return clicked;
 }
 
-static void rotation_data_edit_gui(UI_Layout& layout, Entity& entity) {
+static bool rotation_data_edit_gui(UI_Layout& layout, Entity& entity) {
   auto* rotation = get_rotation(entity);
   ASSERT(rotation, "entity has no rotation to edit");
   bool clicked{};
@@ -81,6 +83,7 @@ static void rotation_data_edit_gui(UI_Layout& layout, Entity& entity) {
   if (clicked) {
     *rotation = next_direction(*rotation);
   }
+  return clicked;
 }
 
 static void
@@ -129,10 +132,10 @@ static void inventory_data_edit_gui(
   const Input& input,
   Entity& entity
 ) {
-  auto* inventory = get_inventory(entity);
-  ASSERT(inventory, "entity has no inventory to edit");
+  auto inventory = get_inventory(entity);
+  ASSERT(!inventory.empty(), "entity has no inventory to edit");
 
-  auto hovered_slot = gui_inventory(layout, assets, entity.id, *inventory);
+  auto hovered_slot = gui_inventory(layout, assets, entity.id, inventory);
   // TODO: this is kind of bad, i should get the information about whether
   // it was clicked or not from the inventory_ui function
   // (and this is not the only place im doing it this way)
@@ -141,7 +144,7 @@ static void inventory_data_edit_gui(
   }
 
   if (editor.selected_inventory_edit_slot.entity == entity.id) {
-    auto& selected_slot = (*inventory)[editor.selected_inventory_edit_slot.slot_idx];
+    auto& selected_slot = inventory[editor.selected_inventory_edit_slot.slot_idx];
 
     ui_element_begin(layout, UI_AUTO_ID);
     {
@@ -330,10 +333,12 @@ static void entity_data_edit_gui(
   UI_Layout& layout,
   const AssetManager& assets,
   const Input& input,
+  EntityStore& store,
   Entity& entity
 ) {
+  bool ports_edited = false;
   if (rotatable(entity)) {
-    rotation_data_edit_gui(layout, entity);
+    ports_edited |= rotation_data_edit_gui(layout, entity);
   }
   if (has_inventory(entity)) {
     inventory_data_edit_gui(editor, layout, assets, input, entity);
@@ -342,11 +347,18 @@ static void entity_data_edit_gui(
     maintenance_data_edit_gui(layout, entity);
   }
   if (is<Conveyor>(entity)) {
-    conveyor_data_edit_gui(layout, entity);
+    ports_edited |= conveyor_data_edit_gui(layout, entity);
   }
   if (is<WorldTunnel>(entity)) {
     world_tunnel_destination_data_edit_gui(layout, entity);
   }
+
+  // NOTE: takes apart the transport lines whose links changed
+  if (ports_edited) {
+    update_neighbours(store, entity.pos, get_dims(entity), entity.world);
+  }
+  // NOTE: inventory/maintenance edits might let it make progress again
+  wake(store, entity.id);
 }
 
 EditorGUIResult editor_gui(
@@ -412,7 +424,7 @@ EditorGUIResult editor_gui(
         ui_text(layout, "selected entity data:", 25, WHITE);
         ui_element_begin(layout, UI_AUTO_ID);
         {
-          entity_data_edit_gui(editor, layout, assets, input, *selected);
+          entity_data_edit_gui(editor, layout, assets, input, store, *selected);
         }
         ui_element_end(layout, {.layout_direction = UI_LAYOUT_DIRECTION_VERTICAL});
       }
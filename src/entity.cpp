@@ -1,7 +1,13 @@
 #include "entity.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
 #include "core.h"
 #include "utils.h"
+#include "profiler.h"
 
 std::string_view world_to_string(World world) {
   switch (world) {
@@ -17,6 +23,30 @@ std::string_view world_to_string(World world) {
   ASSERT(false, "invalid world: %d", i32(world));
 }
 
+std::string_view entity_type_to_string(u32 type) {
+  switch (type) {
+    case ENTITY_TYPE<Block>:
+      return "block";
+    case ENTITY_TYPE<Player>:
+      return "player";
+    case ENTITY_TYPE<Storage>:
+      return "storage";
+    case ENTITY_TYPE<Conveyor>:
+      return "conveyor";
+    case ENTITY_TYPE<Item>:
+      return "item";
+    case ENTITY_TYPE<WorldTunnel>:
+      return "world_tunnel";
+    case ENTITY_TYPE<ResourceMessageSender>:
+      return "resource_message_sender";
+    case ENTITY_TYPE<ResourceMessageReceiver>:
+      return "resource_message_receiver";
+    case ENTITY_TYPE<Assembler>:
+      return "assembler";
+  }
+  ASSERT(false, "invalid entity type: {}", type);
+}
+
 // NOTE: find the y-intercept of a tangent line to a cog_a that is closer to cog_b
 // takes an equation like this
 // y * y_multipler = a * x + _
@@ -35,7 +65,7 @@ static f32 closer_y_intercept_of_tangent_line(const Cogwheel& cog_a, const Cogwh
   return b_2;
 }
 
-void maintenance_init_minigame(MaintenanceLubrication& state) {
+void maintenance_init_minigame(MaintenanceLubrication& state, Random&) {
   // TODO: randomize these in the future
   state.cogwheels.push_back({{64, 64}, 64.0f, WHITE});
   state.cogwheels.push_back({{156, 128}, 48.0f, GRAY});
@@ -111,7 +141,7 @@ bool maintenance_update_minigame(MaintenanceLubrication& state, const Input& inp
   bool done = true;
   for (auto& point : state.points) {
     vec2 origin = point.dims / 2.0f;
-    if (input.lmb.down && CheckCollisionRecs(
+    if (input.lmb.down && rects_overlap(
                             rect_from_vec2x2(point.pos + state.window_offset - origin, point.dims),
                             rect_from_vec2x2(input.mouse_pos, {1, 1})
                           )) {
@@ -127,48 +157,23 @@ bool maintenance_update_minigame(MaintenanceLubrication& state, const Input& inp
   return done;
 }
 
-void maintenance_render_minigame(
-  MaintenanceLubrication& state,
-  const AssetManager&,
-  const RenderTexture2D& render_texture,
-  const vec2& window_offset
-) {
-  // TODO: i really really dont like this, dont know how else to do it tho
-  state.window_offset = window_offset;
-
-  BeginTextureMode(render_texture);
-  ClearBackground(BLACK);
-  for (const auto& cog : state.cogwheels) {
-    DrawCircleV(vec2_to_raylib(cog.pos), cog.radius, cog.color);
-  }
-  for (const auto& point : state.points) {
-    Color color = point.color;
-    if (point.progress >= 1.0f) {
-      color = YELLOW;
-    }
-    DrawRectanglePro(
-      rect_from_vec2x2(point.pos, point.dims),
-      vec2_to_raylib(point.dims / 2.0f),
-      0,
-      color
-    );
-  }
-  EndTextureMode();
-}
-
 // TODO: sometimes it seems like the dirty rects get initialized with progress > 0
-void maintenance_init_minigame(MaintenanceCleaning& state) {
+void maintenance_init_minigame(MaintenanceCleaning& state, Random& random) {
   static constexpr vec2 MAX_DIMS = {96, 96};
   for (i32 i = 0; i < 3; ++i) {
     Rectangle area{};
-    area.x =
-      random_get<f32>(state.OUTER_RECT.x, state.OUTER_RECT.x + state.OUTER_RECT.width - MAX_DIMS.x);
+    area.x = random_get<f32>(
+      random,
+      state.OUTER_RECT.x,
+      state.OUTER_RECT.x + state.OUTER_RECT.width - MAX_DIMS.x
+    );
     area.y = random_get<f32>(
+      random,
       state.OUTER_RECT.y,
       state.OUTER_RECT.y + state.OUTER_RECT.height - MAX_DIMS.y
     );
-    area.width  = random_get<f32>(32, MAX_DIMS.x);
-    area.height = random_get<f32>(32, MAX_DIMS.y);
+    area.width  = random_get<f32>(random, 32, MAX_DIMS.x);
+    area.height = random_get<f32>(random, 32, MAX_DIMS.y);
 
     state.dirty_rects.push_back({area});
   }
@@ -188,7 +193,7 @@ bool maintenance_update_minigame(MaintenanceCleaning& state, const Input& input,
     dirty_rect_check.y += state.window_offset.y;
 
     if (input.lmb.down &&
-        CheckCollisionRecs(dirty_rect_check, rect_from_vec2x2(input.mouse_pos, {1, 1}))) {
+        rects_overlap(dirty_rect_check, rect_from_vec2x2(input.mouse_pos, {1, 1}))) {
       auto moved_dist = length(state.last_mouse_pos - input.mouse_pos);
       dirty_rect.progress += moved_dist * 0.003f;
       // NOTE: clamping to 1.0f to avoid weird rendering glitches with the opacity
@@ -201,28 +206,7 @@ bool maintenance_update_minigame(MaintenanceCleaning& state, const Input& input,
   return done;
 }
 
-void maintenance_render_minigame(
-  MaintenanceCleaning& state,
-  const AssetManager&,
-  const RenderTexture2D& render_texture,
-  const vec2& window_offset
-) {
-  state.window_offset = window_offset;
-
-  BeginTextureMode(render_texture);
-  ClearBackground(BLACK);
-  DrawRectangleLinesEx(state.OUTER_RECT, 5, GRAY);
-  DrawCircleV({128, 128}, 20, GRAY);
-  DrawCircleLinesV({128, 128}, 112, GRAY);
-  for (const auto& dirty_rect : state.dirty_rects) {
-    Color color = BROWN;
-    color.a *= (1.0f - dirty_rect.progress);
-    DrawRectanglePro(dirty_rect.area, {}, 0, color);
-  }
-  EndTextureMode();
-}
-
-void maintenance_init_minigame(MaintenanceComponentReplacement& state) {
+void maintenance_init_minigame(MaintenanceComponentReplacement& state, Random&) {
   state.slots[COMPONENT_SLOT_BROKEN]  = {.pos = {64, 192}};
   state.slots[COMPONENT_SLOT_FIXED]   = {.pos = {192, 192}};
   state.slots[COMPONENT_SLOT_MACHINE] = {.pos = {128, 64}};
@@ -245,7 +229,7 @@ static void update_component(
   const vec2& window_offset
 ) {
   auto origin = comp.DIMS * 0.5f;
-  if (input.lmb.pressed() && CheckCollisionRecs(
+  if (input.lmb.pressed() && rects_overlap(
                                rect_from_vec2x2(comp.pos + window_offset - origin, comp.DIMS),
                                rect_from_vec2x2(input.mouse_pos, {1, 1})
                              )) {
@@ -260,7 +244,7 @@ static void update_component(
         auto& slot       = slots[slot_idx];
         auto slot_origin = slot.DIMS * 0.5f;
         if (other.slot != slot_idx &&
-            CheckCollisionRecs(
+            rects_overlap(
               rect_from_vec2x2(slot.pos + window_offset - slot_origin, slot.DIMS),
               rect_from_vec2x2(input.mouse_pos, {1, 1})
             )) {
@@ -279,43 +263,13 @@ bool maintenance_update_minigame(MaintenanceComponentReplacement& state, const I
   return state.fixed.slot == COMPONENT_SLOT_MACHINE;
 }
 
-static void
-render_component(Component& comp, const AssetManager& assets, TextureType texture_type) {
-  auto& texture     = assets.textures[texture_type];
-  auto texture_dims = dims_from_texture(texture);
-  auto source_rect  = rect_from_vec2x2({}, texture_dims);
-  auto dest_rect    = rect_from_vec2x2(comp.pos, comp.DIMS);
-  auto origin       = comp.DIMS * 0.5f;
-  DrawTexturePro(texture, source_rect, dest_rect, vec2_to_raylib(origin), 0, WHITE);
-}
-
-void maintenance_render_minigame(
-  MaintenanceComponentReplacement& state,
-  const AssetManager& assets,
-  const RenderTexture2D& render_texture,
-  const vec2& window_offset
-) {
-  state.window_offset = window_offset;
-
-  BeginTextureMode(render_texture);
-  ClearBackground(BLACK);
-  for (const auto& slot : state.slots) {
-    auto rect   = rect_from_vec2x2(slot.pos, slot.DIMS);
-    auto origin = slot.DIMS * 0.5f;
-    DrawRectanglePro(rect, vec2_to_raylib(origin), 0, LIGHTGRAY);
-  }
-  render_component(state.broken, assets, get_texture_type(state.FIX_ITEM));
-  render_component(state.fixed, assets, get_texture_type(state.FIX_ITEM));
-  EndTextureMode();
-}
-
-void maintenance_init_minigame(MaintenanceCalibration& state) {
-  state.range_low  = random_get<f32>(30.0f, 50.0f);
+void maintenance_init_minigame(MaintenanceCalibration& state, Random& random) {
+  state.range_low  = random_get<f32>(random, 30.0f, 50.0f);
   state.range_low  = std::round(state.range_low * 10.0f) / 10.0f;
-  state.range_high = state.range_low + random_get<f32>(1.0f, 50.0f);
+  state.range_high = state.range_low + random_get<f32>(random, 1.0f, 50.0f);
   state.range_high = std::round(state.range_high * 10.0f) / 10.0f;
   // TODO: not sure if i want for it to be possible for the value to start in the range
-  state.value = random_get<f32>(0.0f, 100.0f);
+  state.value = random_get<f32>(random, 0.0f, 100.0f);
   state.value = std::round(state.value * 10.0f) / 10.0f;
 }
 
@@ -331,7 +285,7 @@ bool maintenance_update_minigame(MaintenanceCalibration& state, const Input& inp
     {state.add_rect.width, state.add_rect.height}
   );
   if (input.lmb.down &&
-      CheckCollisionRecs(check_add_rect, rect_from_vec2x2(input.mouse_pos, {1, 1}))) {
+      rects_overlap(check_add_rect, rect_from_vec2x2(input.mouse_pos, {1, 1}))) {
     state.value += 0.1f;
   }
   auto check_remove_rect = rect_from_vec2x2(
@@ -339,7 +293,7 @@ bool maintenance_update_minigame(MaintenanceCalibration& state, const Input& inp
     {state.remove_rect.width, state.remove_rect.height}
   );
   if (input.lmb.down &&
-      CheckCollisionRecs(check_remove_rect, rect_from_vec2x2(input.mouse_pos, {1, 1}))) {
+      rects_overlap(check_remove_rect, rect_from_vec2x2(input.mouse_pos, {1, 1}))) {
     state.value -= 0.1f;
   }
   state.value = std::round(state.value * 10.0f) / 10.0f;
@@ -353,54 +307,6 @@ bool maintenance_update_minigame(MaintenanceCalibration& state, const Input& inp
   return state.t >= 0.5f;
 }
 
-// TODO: display the range and the value as a wave
-// the middle of the range would be one displayed wavelength
-// and the value would be the other displayed wavelength
-// amplitude would be constant???
-// and you have to get the value wavelength near the range wavelength
-void maintenance_render_minigame(
-  MaintenanceCalibration& state,
-  const AssetManager&,
-  const RenderTexture2D& render_texture,
-  const vec2& window_offset
-) {
-  state.window_offset = window_offset;
-
-  ASSERT_NO_MSG(
-    state.add_rect.width == state.remove_rect.width &&
-    state.add_rect.height == state.remove_rect.height
-  );
-  vec2 origin     = vec2{state.add_rect.width, state.add_rect.height} / 2.0f;
-  auto value_text = std::format("{}", state.value);
-  auto range_text = std::format("Expected range:\n[{};{}]", state.range_low, state.range_high);
-
-  BeginTextureMode(render_texture);
-  ClearBackground(BLACK);
-  DrawTextPro(
-    GetFontDefault(),
-    range_text.c_str(),
-    {128, 64},
-    MeasureTextEx(GetFontDefault(), range_text.c_str(), 20, 2) / 2.0f,
-    0,
-    20,
-    2,
-    WHITE
-  );
-  DrawTextPro(
-    GetFontDefault(),
-    value_text.c_str(),
-    {128, 128},
-    MeasureTextEx(GetFontDefault(), value_text.c_str(), 20, 2) / 2.0f,
-    0,
-    20,
-    2,
-    WHITE
-  );
-  DrawRectanglePro(state.add_rect, vec2_to_raylib(origin), 0, GREEN);
-  DrawRectanglePro(state.remove_rect, vec2_to_raylib(origin), 0, RED);
-  EndTextureMode();
-}
-
 std::string_view maintenance_name(const Maintenance& maintenance) {
   return std::visit(
     [](const auto& value) -> std::string_view {
@@ -442,12 +348,12 @@ bool* maintenance_is_minigame_open(Maintenance& maintenance) {
   );
 }
 
-void maintenance_init_minigame(Maintenance& maintenance) {
+void maintenance_init_minigame(Maintenance& maintenance, Random& random) {
   std::visit(
-    [](auto& value) {
+    [&](auto& value) {
       using T = std::decay_t<decltype(value)>;
       if constexpr (MaintenanceHasMiniGame<T>) {
-        maintenance_init_minigame(value);
+        maintenance_init_minigame(value, random);
       }
     },
     maintenance
@@ -467,23 +373,6 @@ bool maintenance_update_minigame(Maintenance& maintenance, const Input& input, f
   );
 }
 
-void maintenance_render_minigame(
-  Maintenance& maintenance,
-  const AssetManager& assets,
-  const RenderTexture2D& render_texture,
-  const vec2& window_offset
-) {
-  std::visit(
-    [&](auto& value) {
-      using T = std::decay_t<decltype(value)>;
-      if constexpr (MaintenanceHasMiniGame<T>) {
-        maintenance_render_minigame(value, assets, render_texture, window_offset);
-      }
-    },
-    maintenance
-  );
-}
-
 std::span<ResourceMessage> get_first_resource_message_batch(ResourceMessageQueue& queue) {
   if (queue.msgs.empty()) {
     return {};
@@ -587,133 +476,1057 @@ ItemSlot& assembler_output_slot(Assembler& assembler, u32 idx) {
   return assembler.inventory[idx + Recipe::MAX_INPUT_SLOTS];
 }
 
+template <typename T>
+static void relink_entity_data(EntityPools& pools) {
+  auto& entities = pools.entities[ENTITY_TYPE<T>];
+  auto& data     = std::get<std::vector<T>>(pools.data);
+  for (u32 i = 0; i < entities.size(); ++i) {
+    entities[i].data = &data[i];
+  }
+}
+
+EntityPools::EntityPools(const EntityPools& other) : entities{other.entities}, data{other.data} {
+  for_each_entity_type([&]<typename T>() {
+    relink_entity_data<T>(*this);
+  });
+}
+
+EntityPools& EntityPools::operator=(const EntityPools& other) {
+  entities = other.entities;
+  data     = other.data;
+  for_each_entity_type([&]<typename T>() {
+    relink_entity_data<T>(*this);
+  });
+  return *this;
+}
+
+static Entity& pools_push(EntityPools& pools, EntityPrototype& prototype) {
+  return visit(prototype, [&](auto& value) -> Entity& {
+    using T        = std::decay_t<decltype(value)>;
+    auto& entities = pools.entities[ENTITY_TYPE<T>];
+    auto& data     = std::get<std::vector<T>>(pools.data);
+
+    auto* old_data = data.data();
+    data.push_back(std::move(value));
+    if (data.data() != old_data) {
+      relink_entity_data<T>(pools);
+    }
+    entities.push_back({
+      .id    = prototype.id,
+      .pos   = prototype.pos,
+      .world = prototype.world,
+      .type  = ENTITY_TYPE<T>,
+      .data  = &data.back(),
+    });
+    return entities.back();
+  });
+}
+
+static void pools_reserve(EntityPools& pools, EntityPrototype& prototype, u32 count) {
+  visit(prototype, [&]<typename T>(T&) {
+    auto& entities = pools.entities[ENTITY_TYPE<T>];
+    auto& data     = std::get<std::vector<T>>(pools.data);
+
+    auto* old_data = data.data();
+    data.reserve(data.size() + count);
+    if (data.data() != old_data) {
+      relink_entity_data<T>(pools);
+    }
+    entities.reserve(entities.size() + count);
+  });
+}
+
+static void pools_remove(EntityStore& store, EntityLocation location) {
+  auto& entities = store.pools.entities[location.type];
+  visit(entities[location.idx], [&]<typename T>(T&) {
+    auto& data = std::get<std::vector<T>>(store.pools.data);
+
+    u32 last_idx = entities.size() - 1;
+    if (location.idx != last_idx) {
+      data[location.idx]          = std::move(data[last_idx]);
+      entities[location.idx]      = entities[last_idx];
+      entities[location.idx].data = &data[location.idx];
+      store.locations[entities[location.idx].id.idx - 1].idx = location.idx;
+    }
+    data.pop_back();
+    entities.pop_back();
+  });
+}
+
+// NOTE: gives memory back once a pool is mostly empty, so tearing down a big factory
+// doesnt keep its peak allocation around forever
+static void pools_shrink(EntityPools& pools) {
+  for_each_entity_type([&]<typename T>() {
+    auto& entities = pools.entities[ENTITY_TYPE<T>];
+    auto& data     = std::get<std::vector<T>>(pools.data);
+    if (data.capacity() < POOL_SHRINK_MIN_CAPACITY || data.size() * 4 > data.capacity()) {
+      return;
+    }
+
+    auto* old_data = data.data();
+    data.shrink_to_fit();
+    if (data.data() != old_data) {
+      relink_entity_data<T>(pools);
+    }
+    entities.shrink_to_fit();
+  });
+}
+
+EntityStoreStats entity_store_stats(const EntityStore& store) {
+  EntityStoreStats stats{.slots = u32(store.locations.size())};
+  for (auto& entities : store.pools.entities) {
+    stats.live += entities.size();
+    stats.pool_capacity += entities.capacity();
+  }
+  return stats;
+}
+
 EntityIterator begin(EntityStore& store) {
-  EntityIterator iter{};
-  iter.curr = store.entities.data();
-  iter.end  = iter.curr + store.entities.size();
-  while (iter.curr < iter.end && !iter.curr->id) {
-    ++iter.curr;
+  EntityIterator iter{.entities = &store.pools.entities};
+  while (iter.type < ENTITY_TYPE_COUNT && store.pools.entities[iter.type].empty()) {
+    ++iter.type;
   }
   return iter;
 }
 
 EntityIterator end(EntityStore& store) {
-  EntityIterator iter{};
-  iter.curr = iter.end = store.entities.data() + store.entities.size();
-  return iter;
+  return {.entities = &store.pools.entities, .type = ENTITY_TYPE_COUNT};
 }
 
 static EntityId get_next_entity_id(EntityStore& store) {
-  if (!store.free_slots.empty()) {
+  while (!store.free_slots.empty()) {
     auto id = store.free_slots.back();
     store.free_slots.pop_back();
+    // NOTE: the generation would wrap around, so this slot is never used again
+    if (id.gen == ENTITY_ID_GEN_MAX) {
+      continue;
+    }
     ++id.gen;
     return id;
   }
-  ASSERT(store.next_entity_idx < U16_MAX, "exceeded max entity index");
+  ASSERT(store.next_entity_idx < ENTITY_ID_IDX_MAX, "exceeded max entity index");
   ++store.next_entity_idx;
   return {.idx = store.next_entity_idx, .gen = 0};
 }
 
-EntityId add_entity(EntityStore& store, const Entity& entity) {
-  store.command_buffer.push_back(AddCommand{
-    .entity = entity,
-  });
-  auto* cmd = std::get_if<AddCommand>(&store.command_buffer.back());
-  ASSERT_NO_MSG(cmd);
+EntityId add_entity(EntityStore& store, const EntityPrototype& entity) {
+  auto& commands = store.command_buffer;
+  auto* cmd      = arena_new<AddCommand>(commands.arena, AddCommand{.entity = entity});
   cmd->entity.id = get_next_entity_id(store);
+  commands.adds.push_back(cmd);
   return cmd->entity.id;
 }
 
+void add_entity_with_id(EntityStore& store, EntityPrototype&& entity) {
+  auto& commands = store.command_buffer;
+  auto* cmd      = arena_new<AddCommand>(commands.arena, AddCommand{.entity = std::move(entity)});
+  commands.adds.push_back(cmd);
+}
+
 void remove_entity(EntityStore& store, EntityId id) {
-  store.command_buffer.push_back(RemoveCommand{
-    .id = id,
-  });
+  store.command_buffer.removes.push_back({.id = id});
 }
 
 bool contains_entity(EntityStore& store, EntityId id) {
-  if (!id || id.idx > store.entities.size()) {
+  if (!id || id.idx > store.locations.size()) {
     return false;
   }
-  auto& entity = store.entities[id.idx - 1];
-  return entity.id == id;
+  auto& location = store.locations[id.idx - 1];
+  return location.id == id;
 }
 
 Entity* get_entity(EntityStore& store, EntityId id) {
-  if (!id || id.idx > store.entities.size()) {
+  if (!id || id.idx > store.locations.size()) {
+    return nullptr;
+  }
+  auto& location = store.locations[id.idx - 1];
+  if (location.id != id) {
     return nullptr;
   }
-  auto& entity = store.entities[id.idx - 1];
-  if (entity.id != id) {
+  return &store.pools.entities[location.type][location.idx];
+}
+
+static u64 tile_key(i32 x, i32 y) {
+  return (u64(u32(x)) << 32) | u64(u32(y));
+}
+
+struct TileRange {
+  i32 x_min{};
+  i32 y_min{};
+  i32 x_max{};
+  i32 y_max{};
+};
+
+// NOTE: inclusive range of all the tiles the area touches
+static TileRange tile_range(const vec2& pos, const vec2& dims) {
+  return {
+    .x_min = i32(std::floor(pos.x)),
+    .y_min = i32(std::floor(pos.y)),
+    .x_max = i32(std::ceil(pos.x + dims.x)) - 1,
+    .y_max = i32(std::ceil(pos.y + dims.y)) - 1,
+  };
+}
+
+static bool overlaps(const Entity& entity, const vec2& pos, const vec2& dims) {
+  auto entity_dims = get_dims(entity);
+  bool x_in_range  = pos.x < entity.pos.x + entity_dims.x && pos.x + dims.x > entity.pos.x;
+  bool y_in_range  = pos.y < entity.pos.y + entity_dims.y && pos.y + dims.y > entity.pos.y;
+  return x_in_range && y_in_range;
+}
+
+static u64 chunk_key(i32 x, i32 y) {
+  return tile_key(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+}
+
+static u32 chunk_tile_idx(i32 x, i32 y) {
+  return u32(y & (CHUNK_SIZE - 1)) * CHUNK_SIZE + u32(x & (CHUNK_SIZE - 1));
+}
+
+static const std::vector<EntityId>* find_tile(const SpatialIndex& index, i32 x, i32 y) {
+  auto chunk = index.chunks.find(chunk_key(x, y));
+  if (chunk == index.chunks.end()) {
     return nullptr;
   }
-  return &entity;
+  return &chunk->second.tiles[chunk_tile_idx(x, y)];
+}
+
+static void spatial_index_insert(EntityStore& store, const Entity& entity) {
+  auto& index = store.spatial_index[entity.world];
+  auto range  = tile_range(entity.pos, get_dims(entity));
+  for (i32 y = range.y_min; y <= range.y_max; ++y) {
+    for (i32 x = range.x_min; x <= range.x_max; ++x) {
+      auto& chunk = index.chunks[chunk_key(x, y)];
+      chunk.tiles[chunk_tile_idx(x, y)].push_back(entity.id);
+      ++chunk.tile_entries;
+    }
+  }
+  auto& chunk = index.chunks[chunk_key(range.x_min, range.y_min)];
+  chunk.entities[entity.type].push_back(entity.id);
+}
+
+static void remove_id(std::vector<EntityId>& ids, EntityId id) {
+  for (u32 i = 0; i < ids.size(); ++i) {
+    if (ids[i] == id) {
+      ids[i] = ids.back();
+      ids.pop_back();
+      return;
+    }
+  }
+}
+
+static void spatial_index_remove(EntityStore& store, const Entity& entity) {
+  auto& index = store.spatial_index[entity.world];
+  auto range  = tile_range(entity.pos, get_dims(entity));
+  auto origin = index.chunks.find(chunk_key(range.x_min, range.y_min));
+  if (origin != index.chunks.end()) {
+    remove_id(origin->second.entities[entity.type], entity.id);
+  }
+  for (i32 y = range.y_min; y <= range.y_max; ++y) {
+    for (i32 x = range.x_min; x <= range.x_max; ++x) {
+      auto chunk = index.chunks.find(chunk_key(x, y));
+      if (chunk == index.chunks.end()) {
+        continue;
+      }
+      auto& ids        = chunk->second.tiles[chunk_tile_idx(x, y)];
+      auto before_size = ids.size();
+      remove_id(ids, entity.id);
+      chunk->second.tile_entries -= before_size - ids.size();
+      if (chunk->second.tile_entries == 0) {
+        index.chunks.erase(chunk);
+      }
+    }
+  }
 }
 
 Entity* get_entity_at_pos(EntityStore& store, const vec2& pos, World world, const vec2& dims) {
-  for (auto& entity : store) {
-    auto entity_dims = get_dims(entity);
-    bool same_world  = world == entity.world;
-    bool x_in_range  = pos.x < entity.pos.x + entity_dims.x && pos.x + dims.x > entity.pos.x;
-    bool y_in_range  = pos.y < entity.pos.y + entity_dims.y && pos.y + dims.y > entity.pos.y;
-    if (same_world && x_in_range && y_in_range) {
-      return &entity;
+  auto& index = store.spatial_index[world];
+  auto range  = tile_range(pos, dims);
+  Entity* found{};
+  for (i32 y = range.y_min; y <= range.y_max; ++y) {
+    for (i32 x = range.x_min; x <= range.x_max; ++x) {
+      auto* tile = find_tile(index, x, y);
+      if (!tile) {
+        continue;
+      }
+      for (auto id : *tile) {
+        if (found && found->id.idx <= id.idx) {
+          continue;
+        }
+        auto* entity = get_entity(store, id);
+        ASSERT(entity, "spatial index is out of sync with the entity store");
+        if (overlaps(*entity, pos, dims)) {
+          found = entity;
+        }
+      }
     }
   }
-  return nullptr;
+  return found;
 }
 
 std::vector<Entity*>
 get_entities_at_pos(EntityStore& store, const vec2& pos, World world, const vec2& dims) {
   std::vector<Entity*> entities{};
-  for (auto& entity : store) {
-    auto entity_dims = get_dims(entity);
-    bool same_world  = world == entity.world;
-    bool x_in_range  = pos.x < entity.pos.x + entity_dims.x && pos.x + dims.x > entity.pos.x;
-    bool y_in_range  = pos.y < entity.pos.y + entity_dims.y && pos.y + dims.y > entity.pos.y;
-    if (same_world && x_in_range && y_in_range) {
-      entities.push_back(&entity);
+  auto& index = store.spatial_index[world];
+  auto range  = tile_range(pos, dims);
+  for (i32 y = range.y_min; y <= range.y_max; ++y) {
+    for (i32 x = range.x_min; x <= range.x_max; ++x) {
+      auto* tile = find_tile(index, x, y);
+      if (!tile) {
+        continue;
+      }
+      for (auto id : *tile) {
+        auto* entity = get_entity(store, id);
+        ASSERT(entity, "spatial index is out of sync with the entity store");
+        if (overlaps(*entity, pos, dims)) {
+          entities.push_back(entity);
+        }
+      }
     }
   }
+  // NOTE: multi tile entities can be found in more than one tile
+  std::ranges::sort(entities, [](const Entity* a, const Entity* b) {
+    return a->id.idx < b->id.idx;
+  });
+  auto duplicates = std::ranges::unique(entities);
+  entities.erase(duplicates.begin(), duplicates.end());
   return entities;
 }
 
-void emit(EntityStore& store, const Event& event) {
-  store.event_bus.push_back(event);
+// NOTE: in debug builds the cached neighbours get checked against a full recompute every tick,
+// set it to 0 if it ever gets too slow
+#define VALIDATE_NEIGHBOURS MODE_DEBUG
+
+// NOTE: players and dropped items just pass through, they never connect to a port
+static bool connectable(const Entity& entity) {
+  return !is<Player>(entity) && !is<Item>(entity);
 }
 
-void flush(EntityStore& store) {
-  for (auto& cmd : store.command_buffer) {
-    std::visit(
-      overloaded{
-        [&](const AddCommand& cmd) {
-          if (store.entities.size() < store.next_entity_idx) {
-            store.entities.resize(store.next_entity_idx);
-          }
-          store.entities[cmd.entity.id.idx - 1] = cmd.entity;
-        },
-        [&](const RemoveCommand& cmd) {
-          store.entities[cmd.id.idx - 1] = {};
-          store.free_slots.push_back(cmd.id);
-        },
-      },
-      cmd
+static EntityId neighbour_at_pos(EntityStore& store, const vec2& pos, World world) {
+  for (auto* entity : get_entities_at_pos(store, pos, world, {1, 1})) {
+    if (connectable(*entity)) {
+      return entity->id;
+    }
+  }
+  return NULL_ENTITY;
+}
+
+template <typename T>
+static constexpr u32 output_port_count() {
+  u32 count = 0;
+  for (auto sides : T::OUTPUT_SIDES) {
+    count += std::popcount(sides);
+  }
+  return count;
+}
+
+template <typename T>
+static void compute_neighbours(EntityStore& store, const Entity& entity, T& data) {
+  if constexpr (std::is_same_v<T, Conveyor>) {
+    auto from_pos       = entity.pos + direction_to_vec2(data.rotation);
+    auto to_pos         = entity.pos + direction_to_vec2(data.to);
+    data.from_neighbour = neighbour_at_pos(store, from_pos, entity.world);
+    data.to_neighbour   = neighbour_at_pos(store, to_pos, entity.world);
+  }
+
+  if constexpr (OutputsItems<T>) {
+    static_assert(
+      output_port_count<T>() <= std::tuple_size_v<decltype(T::output_neighbours)>,
+      "output_neighbours cant fit every output port"
     );
+    // NOTE: same order the ports always got visited in
+    static constexpr std::array<Direction, 4> SIDES = {DIR_RIGHT, DIR_DOWN, DIR_LEFT, DIR_UP};
+
+    data.output_neighbours = {};
+    u32 count              = 0;
+    for (u32 y = 0; y < u32(T::DIMS.y); ++y) {
+      for (u32 x = 0; x < u32(T::DIMS.x); ++x) {
+        auto pos = entity.pos + vec2{f32(x), f32(y)};
+        for (auto side : SIDES) {
+          if (!(T::OUTPUT_SIDES[(T::DIMS.x * y) + x] & side)) {
+            continue;
+          }
+          auto id         = neighbour_at_pos(store, pos + direction_to_vec2(side), entity.world);
+          auto* neighbour = get_entity(store, id);
+          if (neighbour && is<Conveyor>(*neighbour) && conveyor_points_from(*neighbour, pos)) {
+            data.output_neighbours[count++] = id;
+          }
+        }
+      }
+    }
+  }
+}
+
+void validate_neighbours(EntityStore& store) {
+#if VALIDATE_NEIGHBOURS
+  for_each_entity_type([&]<typename T>() {
+    if constexpr (std::is_same_v<T, Conveyor> || OutputsItems<T>) {
+      for (auto [entity, data] : view<T>(store)) {
+        T expected = data;
+        compute_neighbours(store, entity, expected);
+        if constexpr (std::is_same_v<T, Conveyor>) {
+          ASSERT(
+            data.from_neighbour == expected.from_neighbour &&
+              data.to_neighbour == expected.to_neighbour,
+            "stale conveyor neighbours on entity {}",
+            u32(entity.id.idx)
+          );
+        }
+        if constexpr (OutputsItems<T>) {
+          ASSERT(
+            data.output_neighbours == expected.output_neighbours,
+            "stale output neighbours on entity {}",
+            u32(entity.id.idx)
+          );
+        }
+      }
+    }
+  });
+#else
+  (void) store;
+#endif
+}
+
+static void activity_insert(ActivitySet& set, EntityId id) {
+  if (set.sparse.size() < id.idx) {
+    set.sparse.resize(id.idx);
+  }
+  if (set.sparse[id.idx - 1] == id) {
+    return;
+  }
+  set.sparse[id.idx - 1] = id;
+  set.active.push_back(id);
+}
+
+void wake_transport_line(ConveyorGraph& graph, u32 line_idx) {
+  auto& line = graph.lines[line_idx];
+  if (!line.active) {
+    line.active = true;
+    graph.active_lines[line.world].push_back(line_idx);
+  }
+}
+
+void wake(EntityStore& store, EntityId id) {
+  auto* entity = get_entity(store, id);
+  if (!entity) {
+    return;
+  }
+
+  auto& graph = store.conveyor_graph;
+  visit(*entity, [&]<typename T>(T&) {
+    if constexpr (std::is_same_v<T, Assembler>) {
+      activity_insert(store.activity[entity->world][ACTIVITY_RECIPES][ENTITY_TYPE<T>], id);
+    }
+    if constexpr (OutputsItems<T>) {
+      activity_insert(store.activity[entity->world][ACTIVITY_OUTPUT][ENTITY_TYPE<T>], id);
+    }
+    // NOTE: a dirty graph wakes every line once it gets rebuilt anyway
+    // (so does a loose conveyor once its line gets built)
+    if constexpr (std::is_same_v<T, Conveyor>) {
+      if (!graph.dirty) {
+        auto line_idx = graph.nodes[store.locations[id.idx - 1].idx].line_idx;
+        if (line_idx != NULL_TRANSPORT_LINE) {
+          wake_transport_line(graph, line_idx);
+        }
+      }
+    }
+  });
+
+  if (!graph.dirty && id.idx - 1u < graph.first_line_by_target.size()) {
+    auto line_idx = graph.first_line_by_target[id.idx - 1];
+    while (line_idx != NULL_TRANSPORT_LINE) {
+      if (graph.lines[line_idx].target == id) {
+        wake_transport_line(graph, line_idx);
+      }
+      line_idx = graph.lines[line_idx].next_line_by_target;
+    }
+  }
+}
+
+void set_entity_pos(EntityStore& store, Entity& entity, const vec2& pos, World world) {
+  auto old_pos   = entity.pos;
+  auto old_world = entity.world;
+  spatial_index_remove(store, entity);
+  entity.pos   = pos;
+  entity.world = world;
+  spatial_index_insert(store, entity);
+
+  if (connectable(entity)) {
+    auto dims = get_dims(entity);
+    update_neighbours(store, old_pos, dims, old_world);
+    update_neighbours(store, pos, dims, world);
+  }
+}
+
+EntityPrototype entity_prototype(const Entity& entity) {
+  return {
+    .id    = entity.id,
+    .pos   = entity.pos,
+    .world = entity.world,
+    .data  = visit(
+      entity,
+      [](const auto& value) -> EntityData {
+        return value;
+      }
+    ),
+  };
+}
+
+void invalidate_conveyor_graph(EntityStore& store) {
+  materialize_transport_lines(store);
+  store.conveyor_graph.dirty = true;
+}
+
+static constexpr u32 NULL_CONVEYOR = std::numeric_limits<u32>::max();
+
+std::pair<u32, f32> transport_line_tile(const TransportLine& line, f32 pos) {
+  u32 tile = u32(std::max(std::ceil(pos) - 1.0f, 0.0f));
+  tile     = std::min(tile, u32(line.conveyors.size() - 1));
+  f32 t    = std::clamp(f32(tile) + 1.0f - pos, 0.0f, 1.0f);
+  return {tile, t};
+}
+
+std::span<TransportLineItem> transport_line_items(TransportLine& line) {
+  return std::span(line.items).subspan(line.items_head);
+}
+
+std::span<const TransportLineItem> transport_line_items(const TransportLine& line) {
+  return std::span(line.items).subspan(line.items_head);
+}
+
+static u32 conveyor_idx(EntityStore& store, EntityId id) {
+  return store.locations[id.idx - 1].idx;
+}
+
+// NOTE: the conveyors it is linked to (both have to point at each other), as dense indices
+static u32 downstream_conveyor(EntityStore& store, Entity& entity, const Conveyor& conveyor) {
+  auto* to_entity = get_entity(store, conveyor.to_neighbour);
+  if (to_entity && is<Conveyor>(*to_entity) && conveyor_points_from(*to_entity, entity.pos)) {
+    return conveyor_idx(store, to_entity->id);
+  }
+  return NULL_CONVEYOR;
+}
+
+static u32 upstream_conveyor(EntityStore& store, Entity& entity, const Conveyor& conveyor) {
+  auto* from_entity = get_entity(store, conveyor.from_neighbour);
+  if (from_entity && is<Conveyor>(*from_entity) && conveyor_points_to(*from_entity, entity.pos)) {
+    return conveyor_idx(store, from_entity->id);
+  }
+  return NULL_CONVEYOR;
+}
+
+static void link_line_target(ConveyorGraph& graph, u32 line_idx, EntityId target) {
+  auto& line  = graph.lines[line_idx];
+  line.target = target;
+  if (!target) {
+    line.next_line_by_target = NULL_TRANSPORT_LINE;
+    return;
+  }
+  if (graph.first_line_by_target.size() < target.idx) {
+    graph.first_line_by_target.resize(target.idx, NULL_TRANSPORT_LINE);
+  }
+  auto& first_line         = graph.first_line_by_target[target.idx - 1];
+  line.next_line_by_target = first_line;
+  first_line               = line_idx;
+}
+
+static void unlink_line_target(ConveyorGraph& graph, u32 line_idx) {
+  auto& line = graph.lines[line_idx];
+  if (!line.target) {
+    return;
+  }
+  auto* link = &graph.first_line_by_target[line.target.idx - 1];
+  while (*link != line_idx) {
+    ASSERT(*link != NULL_TRANSPORT_LINE, "transport line is missing from its target");
+    link = &graph.lines[*link].next_line_by_target;
+  }
+  *link                    = line.next_line_by_target;
+  line.target              = {};
+  line.next_line_by_target = NULL_TRANSPORT_LINE;
+}
+
+static void build_transport_line(EntityStore& store, TransportLine& line) {
+  auto conveyors = view<Conveyor>(store);
+
+  // NOTE: the gaps hold the absolute positions until the items are sorted
+  line.items.clear();
+  line.items_head = 0;
+  for (u32 tile = 0; tile < line.conveyors.size(); ++tile) {
+    for (auto& item : conveyors.data[line.conveyors[tile]].items) {
+      if (item.slot) {
+        line.items.push_back({.slot = item.slot, .gap = f32(tile) + 1.0f - item.t});
+      }
+    }
+  }
+  std::ranges::stable_sort(line.items, {}, &TransportLineItem::gap);
+
+  f32 prev_pos = 0.0f;
+  for (u32 i = 0; i < line.items.size(); ++i) {
+    auto& item = line.items[i];
+    f32 pos    = std::max(item.gap, i == 0 ? 0.0f : prev_pos + CONVEYOR_ITEM_GAP);
+    item.gap   = pos - prev_pos;
+    prev_pos   = pos;
   }
-  store.command_buffer.clear();
+  line.entry_gap   = f32(line.conveyors.size()) - prev_pos;
+  line.stuck_items = 0;
+}
+
+static void materialize_transport_line(EntityStore& store, const TransportLine& line) {
+  auto conveyors = view<Conveyor>(store);
+  for (auto conveyor_idx : line.conveyors) {
+    conveyors.data[conveyor_idx].items = {};
+  }
+
+  f32 pos = 0.0f;
+  for (auto& line_item : transport_line_items(line)) {
+    pos += line_item.gap;
+    auto [tile, t] = transport_line_tile(line, pos);
+
+    // NOTE: floating point error can squeeze one item too many onto a conveyor,
+    // in that case it just goes onto the closest one that still has room
+    ConveyorItem* free_item = nullptr;
+    for (u32 offset = 0; !free_item && offset < line.conveyors.size(); ++offset) {
+      for (u32 candidate : {tile + offset, tile - offset}) {
+        if (free_item || candidate >= line.conveyors.size()) {
+          continue;
+        }
+        auto& items = conveyors.data[line.conveyors[candidate]].items;
+        auto it     = std::ranges::find_if(items, [](const ConveyorItem& item) {
+          return !item.slot;
+        });
+        if (it != items.end()) {
+          free_item = &*it;
+        }
+      }
+    }
+    ASSERT(free_item, "transport line holds more items than its conveyors");
+    *free_item = {.slot = line_item.slot, .t = t};
+  }
+}
+
+// NOTE: walks upstream from the head, the lines are built the same way by a full rebuild
+// and out of the loose conveyors
+template <typename Upstream>
+static u32 push_transport_line(EntityStore& store, u32 head_idx, bool looped, Upstream&& upstream) {
+  auto& graph    = store.conveyor_graph;
+  auto conveyors = view<Conveyor>(store);
+
+  u32 line_idx{};
+  if (graph.free_lines.empty()) {
+    line_idx = graph.lines.size();
+    graph.lines.emplace_back();
+  } else {
+    line_idx = graph.free_lines.back();
+    graph.free_lines.pop_back();
+  }
+  auto& line  = graph.lines[line_idx];
+  line.looped = looped;
+  line.world  = conveyors.entities[head_idx].world;
+
+  u32 idx = head_idx;
+  while (idx != NULL_CONVEYOR && graph.nodes[idx].line_idx == NULL_TRANSPORT_LINE) {
+    graph.nodes[idx] = {.line_idx = line_idx, .line_tile = u32(line.conveyors.size())};
+    line.conveyors.push_back(idx);
+    idx = upstream(idx);
+  }
+  build_transport_line(store, line);
+
+  line.active = true;
+  graph.active_lines[line.world].push_back(line_idx);
+  link_line_target(
+    graph,
+    line_idx,
+    looped ? NULL_ENTITY : conveyors.data[line.conveyors[0]].to_neighbour
+  );
+  return line_idx;
+}
+
+// NOTE: the conveyors go back to holding their own items, until update_conveyor_graph()
+// builds their lines again
+static void take_transport_line_apart(EntityStore& store, u32 line_idx) {
+  auto& graph    = store.conveyor_graph;
+  auto& line     = graph.lines[line_idx];
+  auto& entities = store.pools.entities[ENTITY_TYPE<Conveyor>];
+
+  materialize_transport_line(store, line);
+  for (auto conveyor_idx : line.conveyors) {
+    graph.nodes[conveyor_idx] = {};
+    graph.loose_conveyors.push_back(entities[conveyor_idx].id);
+  }
+  if (line.active) {
+    std::erase(graph.active_lines[line.world], line_idx);
+  }
+  unlink_line_target(graph, line_idx);
+
+  line.conveyors.clear();
+  line.items.clear();
+  line.items_head = 0;
+  line.active     = false;
+  graph.free_lines.push_back(line_idx);
+}
+
+void detach_transport_line(EntityStore& store, EntityId conveyor_id) {
+  auto& graph = store.conveyor_graph;
+  if (graph.dirty) {
+    return;
+  }
+  u32 line_idx = graph.nodes[conveyor_idx(store, conveyor_id)].line_idx;
+  if (line_idx != NULL_TRANSPORT_LINE) {
+    take_transport_line_apart(store, line_idx);
+  }
+}
+
+// NOTE: the nodes are indexed the same way as the conveyor pool, so they get swap removed as well
+static void remove_conveyor_node(EntityStore& store, const EntityLocation& location) {
+  auto& graph = store.conveyor_graph;
+  detach_transport_line(store, location.id);
+
+  u32 last_idx = graph.nodes.size() - 1;
+  if (location.idx != last_idx) {
+    auto& node = graph.nodes[location.idx] = graph.nodes[last_idx];
+    if (node.line_idx != NULL_TRANSPORT_LINE) {
+      graph.lines[node.line_idx].conveyors[node.line_tile] = location.idx;
+    }
+  }
+  graph.nodes.pop_back();
+}
+
+// NOTE: what the line of the conveyor currently links it to, downstream and upstream
+static std::pair<u32, u32> line_links(const ConveyorGraph& graph, u32 idx) {
+  auto& node = graph.nodes[idx];
+  auto& line = graph.lines[node.line_idx];
+  u32 size   = line.conveyors.size();
+
+  u32 downstream = NULL_CONVEYOR;
+  if (node.line_tile > 0) {
+    downstream = line.conveyors[node.line_tile - 1];
+  } else if (line.looped) {
+    downstream = line.conveyors[size - 1];
+  }
+  u32 upstream = NULL_CONVEYOR;
+  if (node.line_tile + 1 < size) {
+    upstream = line.conveyors[node.line_tile + 1];
+  } else if (line.looped) {
+    upstream = line.conveyors[0];
+  }
+  return {downstream, upstream};
+}
+
+// NOTE: only the lines of conveyors that got linked or unlinked have to be taken apart,
+// a head conveyor that just hands off into something else only changes the target of its line
+static void update_conveyor_links(EntityStore& store, Entity& entity, EntityId old_to_neighbour) {
+  auto& graph = store.conveyor_graph;
+  if (graph.dirty) {
+    return;
+  }
+
+  auto& conveyor = *get_data<Conveyor>(entity);
+  u32 idx        = conveyor_idx(store, entity.id);
+  u32 downstream = downstream_conveyor(store, entity, conveyor);
+  u32 upstream   = upstream_conveyor(store, entity, conveyor);
+  u32 line_idx   = graph.nodes[idx].line_idx;
+  if (line_idx != NULL_TRANSPORT_LINE) {
+    auto& line   = graph.lines[line_idx];
+    bool is_head = !line.looped && graph.nodes[idx].line_tile == 0;
+    if (line_links(graph, idx) != std::pair{downstream, upstream}) {
+      take_transport_line_apart(store, line_idx);
+    } else if (is_head && !(conveyor.to_neighbour == old_to_neighbour)) {
+      unlink_line_target(graph, line_idx);
+      link_line_target(graph, line_idx, conveyor.to_neighbour);
+    }
+  }
+
+  // NOTE: newly linked conveyors have to end up in the same line
+  for (auto linked_idx : {downstream, upstream}) {
+    if (linked_idx == NULL_CONVEYOR) {
+      continue;
+    }
+    u32 linked_line_idx = graph.nodes[linked_idx].line_idx;
+    if (linked_line_idx != NULL_TRANSPORT_LINE && graph.nodes[idx].line_idx != linked_line_idx) {
+      take_transport_line_apart(store, linked_line_idx);
+    }
+  }
+}
+
+void update_conveyor_graph(EntityStore& store) {
+  auto& graph = store.conveyor_graph;
+  if (!graph.dirty) {
+    // NOTE: every conveyor linked to a loose one is loose as well,
+    // so walking downstream from one only ever finds loose conveyors
+    auto conveyors = view<Conveyor>(store);
+    auto upstream  = [&](u32 idx) {
+      return upstream_conveyor(store, conveyors.entities[idx], conveyors.data[idx]);
+    };
+    for (auto id : graph.loose_conveyors) {
+      auto* entity = get_entity(store, id);
+      if (!entity || !is<Conveyor>(*entity)) {
+        continue;
+      }
+      u32 idx = conveyor_idx(store, id);
+      if (graph.nodes[idx].line_idx != NULL_TRANSPORT_LINE) {
+        continue;
+      }
+
+      u32 head_idx = idx;
+      bool looped  = false;
+      while (true) {
+        auto& head = conveyors.entities[head_idx];
+        u32 next   = downstream_conveyor(store, head, conveyors.data[head_idx]);
+        if (next == NULL_CONVEYOR) {
+          break;
+        }
+        ASSERT(
+          graph.nodes[next].line_idx == NULL_TRANSPORT_LINE,
+          "conveyor {} is linked to a line that didnt get taken apart",
+          u32(id.idx)
+        );
+        // NOTE: a cycle, which can just start anywhere
+        if (next == idx) {
+          looped = true;
+          break;
+        }
+        head_idx = next;
+      }
+      push_transport_line(store, head_idx, looped, upstream);
+    }
+    graph.loose_conveyors.clear();
+    return;
+  }
+
+  auto conveyors = view<Conveyor>(store);
+  u32 count      = conveyors.entities.size();
+
+  std::vector<u32> upstream(count, NULL_CONVEYOR);
+  std::vector<bool> has_downstream(count);
+  for (u32 i = 0; i < count; ++i) {
+    u32 downstream = downstream_conveyor(store, conveyors.entities[i], conveyors.data[i]);
+    if (downstream != NULL_CONVEYOR) {
+      upstream[downstream] = i;
+      has_downstream[i]    = true;
+    }
+  }
+
+  graph.lines.clear();
+  graph.free_lines.clear();
+  graph.loose_conveyors.clear();
+  graph.nodes.assign(count, {});
+  for (auto& active_lines : graph.active_lines) {
+    active_lines.clear();
+  }
+  graph.first_line_by_target.assign(store.locations.size(), NULL_TRANSPORT_LINE);
+
+  auto upstream_of = [&](u32 idx) {
+    return upstream[idx];
+  };
+  for (u32 i = 0; i < count; ++i) {
+    if (!has_downstream[i]) {
+      push_transport_line(store, i, false, upstream_of);
+    }
+  }
+  // NOTE: whatever is left is part of a cycle, which can just start anywhere
+  for (u32 i = 0; i < count; ++i) {
+    if (graph.nodes[i].line_idx == NULL_TRANSPORT_LINE) {
+      push_transport_line(store, i, true, upstream_of);
+    }
+  }
+
+  graph.dirty = false;
+}
+
+void materialize_transport_lines(EntityStore& store) {
+  if (store.conveyor_graph.dirty) {
+    return;
+  }
+  for (auto& line : store.conveyor_graph.lines) {
+    materialize_transport_line(store, line);
+  }
+}
+
+bool transport_line_push(TransportLine& line, const ItemSlot& slot) {
+  auto items = transport_line_items(line);
+  if (!items.empty() && line.entry_gap < CONVEYOR_ITEM_GAP) {
+    return false;
+  }
+  // NOTE: the gaps could fit one more item (at both ends of the line),
+  // but then it wouldnt fit onto the conveyors anymore once they get written back
+  if (items.size() >= line.conveyors.size() * CONVEYOR_THROUGHPUT) {
+    return false;
+  }
+  // NOTE: with no items the entry gap is the whole line, so it works out for the head item too
+  line.items.push_back({.slot = slot, .gap = line.entry_gap});
+  line.entry_gap = 0.0f;
+  return true;
+}
+
+bool transport_line_push(EntityStore& store, Entity& conveyor_entity, const ItemSlot& slot) {
+  auto& graph = store.conveyor_graph;
+  ASSERT(!graph.dirty, "transport lines get pushed onto before the conveyor graph got updated");
+  auto& node  = graph.nodes[&conveyor_entity - store.pools.entities[ENTITY_TYPE<Conveyor>].data()];
+  auto& line  = graph.lines[node.line_idx];
+  if (node.line_tile != line.conveyors.size() - 1 || !transport_line_push(line, slot)) {
+    return false;
+  }
+  wake_transport_line(graph, node.line_idx);
+  return true;
+}
+
+void transport_line_pop(TransportLine& line) {
+  f32 gap = line.items[line.items_head].gap;
+  ++line.items_head;
+  // NOTE: with the head gone every item can move again
+  line.stuck_items = 0;
+  if (line.items_head == line.items.size()) {
+    line.items.clear();
+    line.items_head = 0;
+    line.entry_gap  = f32(line.conveyors.size());
+    return;
+  }
+  line.items[line.items_head].gap += gap;
+  if (line.items_head * 2 >= line.items.size()) {
+    line.items.erase(line.items.begin(), line.items.begin() + line.items_head);
+    line.items_head = 0;
+  }
+}
+
+// NOTE: everything upstream of the first item that isnt stuck moves along with it,
+// so only its gap changes, unless it closes up on the item ahead of it,
+// then whatever distance is left goes to the next item upstream that isnt stuck
+bool transport_line_move(TransportLine& line, f32 distance) {
+  auto items = transport_line_items(line);
+  bool moved = false;
+  for (u32 i = line.stuck_items; i < items.size() && distance > 0.0f; ++i) {
+    auto& item  = items[i];
+    f32 min_gap = i == 0 ? 0.0f : CONVEYOR_ITEM_GAP;
+    f32 closed  = std::min(distance, std::max(item.gap - min_gap, 0.0f));
+    item.gap -= closed;
+    line.entry_gap += closed;
+    distance -= closed;
+    moved |= closed > 0.0f;
+    if (item.gap <= min_gap && i == line.stuck_items) {
+      item.gap = min_gap;
+      ++line.stuck_items;
+    }
+  }
+  return moved;
+}
+
+void update_neighbours(EntityStore& store, const vec2& pos, const vec2& dims, World world) {
+  // NOTE: every port sits right next to its entity,
+  // so only entities overlapping the area grown by a tile can have one on it
+  for (auto* entity : get_entities_at_pos(store, pos - vec2{1, 1}, world, dims + vec2{2, 2})) {
+    visit(*entity, [&]<typename T>(T& data) {
+      if constexpr (std::is_same_v<T, Conveyor>) {
+        // NOTE: the transport lines keep track of what they hand off into
+        auto old_to_neighbour = data.to_neighbour;
+        compute_neighbours(store, *entity, data);
+        update_conveyor_links(store, *entity, old_to_neighbour);
+      } else {
+        compute_neighbours(store, *entity, data);
+      }
+    });
+    wake(store, entity->id);
+  }
+}
+
+void flush(EntityStore& store) {
+  PROFILE_SCOPE("flush", PROFILER_ZONE_DETAIL);
+  auto& commands = store.command_buffer;
+  if (store.locations.size() < store.next_entity_idx) {
+    store.locations.resize(store.next_entity_idx);
+  }
+
+  // NOTE: adds go first, so adding and removing an entity in the same tick works out
+  // grouped by type and sorted by idx, so the pools and the location table get written in order
+  std::ranges::sort(commands.adds, [](const AddCommand* a, const AddCommand* b) {
+    auto a_type = a->entity.data.index();
+    auto b_type = b->entity.data.index();
+    return a_type < b_type || (a_type == b_type && a->entity.id.idx < b->entity.id.idx);
+  });
+  for (u32 i = 0; i < commands.adds.size(); ++i) {
+    auto& cmd = *commands.adds[i];
+    if (i == 0 || commands.adds[i - 1]->entity.data.index() != cmd.entity.data.index()) {
+      u32 count = 1;
+      while (i + count < commands.adds.size() &&
+             commands.adds[i + count]->entity.data.index() == cmd.entity.data.index()) {
+        ++count;
+      }
+      pools_reserve(store.pools, cmd.entity, count);
+    }
+
+    auto& entity                           = pools_push(store.pools, cmd.entity);
+    store.locations[cmd.entity.id.idx - 1] = {
+      .id   = entity.id,
+      .type = entity.type,
+      .idx  = u32(store.pools.entities[entity.type].size() - 1),
+    };
+    // NOTE: it gets a line once update_conveyor_graph() runs, until then it holds its own items
+    if (is<Conveyor>(entity) && !store.conveyor_graph.dirty) {
+      store.conveyor_graph.nodes.emplace_back();
+      store.conveyor_graph.loose_conveyors.push_back(entity.id);
+    }
+    spatial_index_insert(store, entity);
+    update_neighbours(store, entity.pos, get_dims(entity), entity.world);
+    std::destroy_at(&cmd);
+  }
+
+  // NOTE: going from the back of every pool, so swap removing never moves an entity
+  // that is about to get removed as well (dead ids just go last)
+  auto remove_order = [&](const RemoveCommand& cmd) -> std::pair<u32, u32> {
+    if (!contains_entity(store, cmd.id)) {
+      return {ENTITY_TYPE_COUNT, 0};
+    }
+    auto& location = store.locations[cmd.id.idx - 1];
+    return {location.type, U32_MAX - location.idx};
+  };
+  std::ranges::sort(commands.removes, {}, remove_order);
+  for (auto& cmd : commands.removes) {
+    auto* entity = get_entity(store, cmd.id);
+    if (!entity) {
+      continue;
+    }
+    spatial_index_remove(store, *entity);
+    auto pos      = entity->pos;
+    auto dims     = get_dims(*entity);
+    auto world    = entity->world;
+    auto location = store.locations[cmd.id.idx - 1];
+    if (is<Conveyor>(*entity) && !store.conveyor_graph.dirty) {
+      remove_conveyor_node(store, location);
+    }
+    pools_remove(store, location);
+    store.locations[cmd.id.idx - 1] = {};
+    store.free_slots.push_back(cmd.id);
+    update_neighbours(store, pos, dims, world);
+  }
+  if (!commands.removes.empty()) {
+    pools_shrink(store.pools);
+  }
+
+  commands.adds.clear();
+  commands.removes.clear();
+  arena_reset(commands.arena);
+}
+
+template <typename T>
+static void clear_event_channel(EventChannel<T>& channel) {
+  channel.head  = (channel.head + channel.count) & (channel.buffer.size() - 1);
+  channel.count = 0;
 }
 
 void clear_event_bus(EntityStore& store) {
-  store.event_bus.clear();
+  std::apply(
+    [](auto&... channels) {
+      (clear_event_channel(channels), ...);
+    },
+    store.event_channels
+  );
 }
 
 bool rotatable(const Entity& entity) {
-  return std::visit(
+  return visit(
+    entity,
     [](const auto& value) {
       using T = std::decay_t<decltype(value)>;
       return Rotatable<T>;
-    },
-    entity.data
+    }
   );
 }
 
@@ -753,7 +1566,8 @@ std::optional<bool> rotatable(ItemType type) {
 }
 
 bool solid(const Entity& entity) {
-  return std::visit(
+  return visit(
+    entity,
     [](auto& value) {
       using T = std::decay_t<decltype(value)>;
       if constexpr (is_any_of<
@@ -769,13 +1583,13 @@ bool solid(const Entity& entity) {
       } else {
         static_assert(false);
       }
-    },
-    entity.data
+    }
   );
 }
 
 bool breakable(const Entity& entity) {
-  return std::visit(
+  return visit(
+    entity,
     [](const auto& value) {
       using T = std::decay_t<decltype(value)>;
       if constexpr (is_any_of<T, Storage, Conveyor, Assembler>) {
@@ -792,13 +1606,13 @@ bool breakable(const Entity& entity) {
       } else {
         static_assert(false);
       }
-    },
-    entity.data
+    }
   );
 }
 
 bool has_gui(const Entity& entity) {
-  return std::visit(
+  return visit(
+    entity,
     [](const auto& value) {
       using T = std::decay_t<decltype(value)>;
       if constexpr (is_any_of<
@@ -814,33 +1628,33 @@ bool has_gui(const Entity& entity) {
       } else {
         static_assert(false);
       }
-    },
-    entity.data
+    }
   );
 }
 
 bool has_inventory(const Entity& entity) {
-  return std::visit(
+  return visit(
+    entity,
     [](const auto& value) {
       using T = std::decay_t<decltype(value)>;
       return HasInventory<T>;
-    },
-    entity.data
+    }
   );
 }
 
 bool has_maintenance(const Entity& entity) {
-  return std::visit(
+  return visit(
+    entity,
     [](const auto& value) {
       using T = std::decay_t<decltype(value)>;
       return HasMaintenance<T>;
-    },
-    entity.data
+    }
   );
 };
 
 std::optional<ItemType> entity_to_item(const Entity& entity) {
-  return std::visit(
+  return visit(
+    entity,
     overloaded{
       [](const Player&) -> std::optional<ItemType> {
         return std::nullopt;
@@ -869,12 +1683,11 @@ std::optional<ItemType> entity_to_item(const Entity& entity) {
       [](const Assembler&) -> std::optional<ItemType> {
         return {ITEM_ASSEMBLER};
       }
-    },
-    entity.data
+    }
   );
 }
 
-std::optional<Entity> entity_from_item(ItemType item) {
+std::optional<EntityPrototype> entity_from_item(ItemType item) {
   switch (item) {
     case ITEM_BLOCK:
       return {{.data = Block{}}};
@@ -909,56 +1722,62 @@ std::optional<Entity> entity_from_item(ItemType item) {
   ASSERT(false, "invalid item type: %d\n", i32(item));
 }
 
+static constexpr overloaded TEXTURE_TYPE_VISITOR{
+  [](const Player&) {
+    return TEXTURE_PLAYER;
+  },
+  [](const Block&) {
+    return TEXTURE_BLOCK;
+  },
+  [](const Storage&) {
+    return TEXTURE_STORAGE;
+  },
+  [](const Conveyor&) {
+    return TEXTURE_CONVEYOR;
+  },
+  [](const Item&) -> TextureType {
+    ASSERT(
+      false,
+      "the item entity does not have a render rect, use its items render rect instead"
+    );
+  },
+  [](const WorldTunnel&) {
+    return TEXTURE_WORLD_TUNNEL;
+  },
+  [](const ResourceMessageSender&) {
+    return TEXTURE_MESSAGE_SENDER;
+  },
+  [](const ResourceMessageReceiver&) {
+    return TEXTURE_MESSAGE_RECEIVER;
+  },
+  [](const Assembler&) {
+    return TEXTURE_ASSEMBLER;
+  }
+};
+
 TextureType get_texture_type(const Entity& entity) {
-  return std::visit(
-    overloaded{
-      [](const Player&) {
-        return TEXTURE_PLAYER;
-      },
-      [](const Block&) {
-        return TEXTURE_BLOCK;
-      },
-      [](const Storage&) {
-        return TEXTURE_STORAGE;
-      },
-      [](const Conveyor&) {
-        return TEXTURE_CONVEYOR;
-      },
-      [](const Item&) -> TextureType {
-        ASSERT(
-          false,
-          "the item entity does not have a render rect, use its items render rect instead"
-        );
-      },
-      [](const WorldTunnel&) {
-        return TEXTURE_WORLD_TUNNEL;
-      },
-      [](const ResourceMessageSender&) {
-        return TEXTURE_MESSAGE_SENDER;
-      },
-      [](const ResourceMessageReceiver&) {
-        return TEXTURE_MESSAGE_RECEIVER;
-      },
-      [](const Assembler&) {
-        return TEXTURE_ASSEMBLER;
-      }
-    },
-    entity.data
-  );
+  return visit(entity, TEXTURE_TYPE_VISITOR);
+}
+
+TextureType get_texture_type(const EntityPrototype& entity) {
+  return visit(entity, TEXTURE_TYPE_VISITOR);
 }
 
+static constexpr auto ROTATION_VISITOR = [](auto& value) -> Direction* {
+  using T = std::decay_t<decltype(value)>;
+  if constexpr (Rotatable<T>) {
+    return &value.rotation;
+  } else {
+    return nullptr;
+  }
+};
+
 Direction* get_rotation(Entity& entity) {
-  return std::visit(
-    [](auto& value) -> Direction* {
-      using T = std::decay_t<decltype(value)>;
-      if constexpr (Rotatable<T>) {
-        return &value.rotation;
-      } else {
-        return nullptr;
-      }
-    },
-    entity.data
-  );
+  return visit(entity, ROTATION_VISITOR);
+}
+
+Direction* get_rotation(EntityPrototype& entity) {
+  return visit(entity, ROTATION_VISITOR);
 }
 
 Direction* get_rotation(EntityStore& store, EntityId id) {
@@ -969,30 +1788,31 @@ Direction* get_rotation(EntityStore& store, EntityId id) {
   return nullptr;
 }
 
-std::vector<ItemSlot>* get_inventory(Entity& entity) {
-  return std::visit(
-    [](auto& value) -> std::vector<ItemSlot>* {
+std::span<ItemSlot> get_inventory(Entity& entity) {
+  return visit(
+    entity,
+    [](auto& value) -> std::span<ItemSlot> {
       using T = std::decay_t<decltype(value)>;
       if constexpr (HasInventory<T>) {
-        return &value.inventory;
+        return value.inventory;
       } else {
-        return nullptr;
+        return {};
       }
-    },
-    entity.data
+    }
   );
 }
 
-std::vector<ItemSlot>* get_inventory(EntityStore& store, EntityId id) {
+std::span<ItemSlot> get_inventory(EntityStore& store, EntityId id) {
   auto* entity = get_entity(store, id);
   if (entity) {
     return get_inventory(*entity);
   }
-  return nullptr;
+  return {};
 }
 
 std::tuple<Maintenance*, std::span<const Maintenance>> get_maintenance(Entity& entity) {
-  return std::visit(
+  return visit(
+    entity,
     [](auto& value) -> std::tuple<Maintenance*, std::span<const Maintenance>> {
       using T = std::decay_t<decltype(value)>;
       if constexpr (HasMaintenance<T>) {
@@ -1000,8 +1820,7 @@ std::tuple<Maintenance*, std::span<const Maintenance>> get_maintenance(Entity& e
       } else {
         return {nullptr, {}};
       }
-    },
-    entity.data
+    }
   );
 }
 
@@ -1015,7 +1834,8 @@ get_maintenance(EntityStore& store, EntityId id) {
 }
 
 OutputsItemsProperties get_outputs_items_properties(Entity& entity) {
-  return std::visit(
+  return visit(
+    entity,
     [](auto& value) -> OutputsItemsProperties {
       using T = std::decay_t<decltype(value)>;
       if constexpr (OutputsItems<T>) {
@@ -1026,8 +1846,7 @@ OutputsItemsProperties get_outputs_items_properties(Entity& entity) {
         };
       }
       return {};
-    },
-    entity.data
+    }
   );
 }
 
@@ -1039,13 +1858,16 @@ OutputsItemsProperties get_outputs_items_properties(EntityStore& store, EntityId
   return {};
 }
 
+static constexpr auto DIMS_VISITOR = [](const auto& value) -> vec2 {
+  return value.DIMS;
+};
+
 vec2 get_dims(const Entity& entity) {
-  return std::visit(
-    [](const auto& value) -> vec2 {
-      return value.DIMS;
-    },
-    entity.data
-  );
+  return visit(entity, DIMS_VISITOR);
+}
+
+vec2 get_dims(const EntityPrototype& entity) {
+  return visit(entity, DIMS_VISITOR);
 }
 
 vec2 get_dims(EntityStore& store, EntityId id) {
@@ -1056,93 +1878,6 @@ vec2 get_dims(EntityStore& store, EntityId id) {
   return {};
 }
 
-void render_entities(EntityStore& store, World world, const AssetManager& assets) {
-  static constexpr f32 ON_CONVEYOR_SCALE = 0.375f;
-
-  for (auto& entity : store) {
-    if (entity.world != world) {
-      continue;
-    }
-
-    const Texture2D* texture{};
-    if (auto* item = get_data<Item>(entity)) {
-      texture = &assets.textures[get_texture_type(item->slot.type)];
-    } else {
-      texture = &assets.textures[get_texture_type(entity)];
-    }
-    // TODO: this makes rendering item entities even worse
-    vec2 dims = get_dims(entity) * GRID_DIMS;
-    vec2 source_pos{};
-    vec2 source_dims = dims;
-
-    // TODO: probably it would be better to just suck it up, and draw all the variants
-    if (auto* conveyor = get_data<Conveyor>(entity)) {
-      bool is_corner = conveyor->to != opposite_direction(conveyor->rotation);
-      if (is_corner) {
-        bool flip = conveyor->to == next_direction(conveyor->rotation);
-        if (flip) {
-          source_dims.x *= -1;
-        }
-        source_pos = vec2{conveyor->DIMS.x * GRID_DIMS.x, 0};
-      }
-    }
-
-    auto source_rect    = rect_from_vec2x2(source_pos, source_dims);
-    Rectangle dest_rect = {
-      .x      = entity.pos.x * GRID_DIMS.x + (GRID_DIMS.x * 0.5f),
-      .y      = entity.pos.y * GRID_DIMS.y + (GRID_DIMS.y * 0.5f),
-      .width  = dims.x,
-      .height = dims.y,
-    };
-    auto origin = vec2_to_raylib(dims * 0.5f);
-
-    if (is<Player>(entity)) {
-      auto actual_pos = player_actual_pos(entity);
-      dest_rect.x     = actual_pos.x * GRID_DIMS.x + (GRID_DIMS.x * 0.5f);
-      dest_rect.y     = actual_pos.y * GRID_DIMS.y + (GRID_DIMS.y * 0.5f);
-    }
-
-    f32 rotation = 0;
-    if (auto* rot = get_rotation(entity)) {
-      rotation = rotation_degrees(*rot);
-    }
-
-    DrawTexturePro(*texture, source_rect, dest_rect, origin, rotation, WHITE);
-
-    if (auto* conveyor = get_data<Conveyor>(entity)) {
-      for (u32 i = 0; i < CONVEYOR_THROUGHPUT; ++i) {
-        auto& item = conveyor->items[i];
-        if (item.slot) {
-          auto& on_texture  = assets.textures[get_texture_type(item.slot.type)];
-          vec2 on_dims      = dims_from_texture(on_texture);
-          Vector2 on_origin = vec2_to_raylib(on_dims) * 0.5f * ON_CONVEYOR_SCALE;
-
-          auto on_source_rect = rect_from_vec2x2({}, on_dims);
-
-          Rectangle on_dest_rect = {
-            .x      = (entity.pos.x * GRID_DIMS.x) + (GRID_DIMS.x * 0.5f),
-            .y      = (entity.pos.y * GRID_DIMS.y) + (GRID_DIMS.y * 0.5f),
-            .width  = on_dims.x * ON_CONVEYOR_SCALE,
-            .height = on_dims.y * ON_CONVEYOR_SCALE,
-          };
-
-          if (item.t < 0.5f) {
-            f32 t = 0.5f - item.t;
-            on_dest_rect.x += (direction_to_vec2(conveyor->rotation).x * t) * GRID_DIMS.x;
-            on_dest_rect.y += (direction_to_vec2(conveyor->rotation).y * t) * GRID_DIMS.y;
-          } else {
-            f32 t = item.t - 0.5f;
-            on_dest_rect.x += (direction_to_vec2(conveyor->to).x * t) * GRID_DIMS.x;
-            on_dest_rect.y += (direction_to_vec2(conveyor->to).y * t) * GRID_DIMS.y;
-          }
-
-          DrawTexturePro(on_texture, on_source_rect, on_dest_rect, on_origin, 0, WHITE);
-        }
-      }
-    }
-  }
-}
-
 vec2 player_actual_pos(Entity& entity) {
   vec2 pos     = entity.pos;
   auto* player = get_data<Player>(entity);
@@ -1167,7 +1902,7 @@ bool conveyor_points_from(Entity& entity, const vec2& pos) {
   return entity.pos + direction_to_vec2(conveyor->rotation) == pos;
 }
 
-void set_conveyor_from_direction(EntityStore& store, Entity& entity) {
+void set_conveyor_from_direction(EntityStore& store, EntityPrototype& entity) {
   auto* conveyor = get_data<Conveyor>(entity);
   ASSERT_NO_MSG(conveyor);
   conveyor->rotation = opposite_direction(conveyor->to);
@@ -3,9 +3,16 @@
 #include <string_view>
 #include <vector>
 #include <variant>
+#include <unordered_map>
+#include <tuple>
+#include <limits>
+#include <span>
+#include <utility>
+#include <type_traits>
 
 #include "core.h"
 #include "math.h"
+#include "arena.h"
 #include "utils.h"
 #include "input.h"
 #include "items.h"
@@ -31,6 +38,7 @@ concept OutputsItems = HasInventory<T> && requires(T t) {
   // NOTE: items/sec
   T::OUTPUT_RATE;
   t.item_output_accumulator;
+  t.output_neighbours;
 };
 
 struct OutputsItemsProperties {
@@ -39,10 +47,29 @@ struct OutputsItemsProperties {
   f32* item_output_accumulator{};
 };
 
-// NOTE: i dont think i will have more than U16_MAX(65'536) entities
+// NOTE: the bit widths can be overridden at compile time, e.g. 32/32 for a 64 bit handle
+#ifndef ENTITY_ID_IDX_BITS
+#define ENTITY_ID_IDX_BITS 24
+#endif
+#ifndef ENTITY_ID_GEN_BITS
+#define ENTITY_ID_GEN_BITS 8
+#endif
+static_assert(
+  ENTITY_ID_IDX_BITS + ENTITY_ID_GEN_BITS == 32 || ENTITY_ID_IDX_BITS + ENTITY_ID_GEN_BITS == 64,
+  "entity ids have to be either 32 or 64 bits"
+);
+static_assert(ENTITY_ID_IDX_BITS <= 32 && ENTITY_ID_GEN_BITS <= 32);
+
+using EntityIdBits = std::conditional_t<ENTITY_ID_IDX_BITS + ENTITY_ID_GEN_BITS == 32, u32, u64>;
+
+static constexpr u32 ENTITY_ID_IDX_MAX = u32((u64(1) << ENTITY_ID_IDX_BITS) - 1);
+static constexpr u32 ENTITY_ID_GEN_MAX = u32((u64(1) << ENTITY_ID_GEN_BITS) - 1);
+
 struct EntityId {
-  u16 idx{};
-  u16 gen{};
+  EntityIdBits idx : ENTITY_ID_IDX_BITS {};
+  // NOTE: slots whose generation reached ENTITY_ID_GEN_MAX are retired instead of wrapping around,
+  // so a stale id can never point at a new entity
+  EntityIdBits gen : ENTITY_ID_GEN_BITS {};
 
   inline bool operator==(EntityId other) const {
     return idx == other.idx && gen == other.gen;
@@ -54,17 +81,22 @@ struct EntityId {
 };
 
 static constexpr EntityId NULL_ENTITY = {0, 0};
+static_assert(sizeof(EntityId) == sizeof(EntityIdBits));
+
+// NOTE: the conveyors an entity outputs into, filled from the front (the first NULL_ENTITY ends it)
+template <u32 N>
+using OutputNeighbours = std::array<EntityId, N>;
 
 enum EventType {
   EVENT_PLAYER_COLLIDED,
+
+  EVENT_TYPE_COUNT,
 };
 
-// TODO: can i somehow use Events as a std::variant?
-// i would still need to keep EventType for listen()
-// (or just pass the EventType as a template)
-struct Event {
-  EventType type{};
-  // NOTE: PLAYER_COLLIDED
+// NOTE: every event type is its own struct, and gets its own channel in the EntityStore
+struct PlayerCollidedEvent {
+  static constexpr EventType TYPE = EVENT_PLAYER_COLLIDED;
+
   EntityId entity{};
 };
 
@@ -77,6 +109,28 @@ struct ItemSlotIdx {
   }
 };
 
+enum GuiActionType : u8 {
+  GUI_ACTION_FIX_MAINTENANCE,
+  GUI_ACTION_SELECT_RECIPE,
+  GUI_ACTION_SWITCH_SENDER_PAGE,
+  GUI_ACTION_ADD_REQUESTED_ITEM,
+  GUI_ACTION_REMOVE_REQUESTED_ITEM,
+  GUI_ACTION_CREATE_MESSAGE,
+  GUI_ACTION_CANCEL_MESSAGE,
+
+  GUI_ACTION_TYPE_COUNT,
+};
+
+// NOTE: a click in the gui that changes the simulation, the gui runs per frame,
+// so it only queues these and the next tick applies them (see system_apply_gui_actions())
+struct GuiAction {
+  GuiActionType type{};
+  // NOTE: the entity whose gui it got clicked in
+  EntityId entity{};
+  // NOTE: the recipe, sender page, requestable item or message, depending on the type
+  u32 idx{};
+};
+
 static constexpr u32 PLAYER_INVENTORY_SIZE = 16;
 
 static constexpr f32 PLAYER_MOVE_ACTION_DURATION = 0.15f;
@@ -85,13 +139,13 @@ struct MovementAction {
   Direction direction{};
   f32 t{};
   // TODO: i dont really like keeping a std::vector here, but i dont know what else to do
-  std::vector<Event> collision_events;
+  std::vector<PlayerCollidedEvent> collision_events;
 };
 
 struct Player {
   static constexpr vec2 DIMS = {1, 1};
 
-  std::vector<ItemSlot> inventory = std::vector<ItemSlot>(PLAYER_INVENTORY_SIZE);
+  Inventory<PLAYER_INVENTORY_SIZE> inventory{};
 
   i32 interaction_radius = 4;
   EntityId open_gui{};
@@ -120,11 +174,14 @@ struct Storage {
   };
   static constexpr f32 OUTPUT_RATE = 2;
   f32 item_output_accumulator{};
+  // NOTE: cached by update_neighbours()
+  OutputNeighbours<4> output_neighbours{};
 
-  std::vector<ItemSlot> inventory = std::vector<ItemSlot>(STORAGE_INVENTORY_SIZE);
+  Inventory<STORAGE_INVENTORY_SIZE> inventory{};
 };
 static_assert(OutputsItems<Storage>);
 static_assert(HasInventory<Storage>);
+static_assert(std::is_trivially_copyable_v<Storage>);
 
 struct ConveyorItem {
   ItemSlot slot{};
@@ -137,6 +194,8 @@ struct ConveyorItem {
 // (for example have multiple types of conveyors that have different speeds
 //  (they might be different entity types tho))
 static constexpr u32 CONVEYOR_THROUGHPUT = 10;
+// NOTE: minimum distance between two items on a transport line
+static constexpr f32 CONVEYOR_ITEM_GAP = 1.0f / CONVEYOR_THROUGHPUT;
 
 struct Conveyor {
   static constexpr vec2 DIMS = {1, 1};
@@ -145,9 +204,17 @@ struct Conveyor {
   Direction rotation = DIR_DOWN;
   Direction to       = DIR_UP;
 
-  std::vector<ConveyorItem> items = std::vector<ConveyorItem>(CONVEYOR_THROUGHPUT);
+  // NOTE: whatever sits on the from/to tile, cached by update_neighbours()
+  EntityId from_neighbour{};
+  EntityId to_neighbour{};
+
+  // NOTE: only up to date while the conveyor graph is dirty or the conveyor isnt part of a line
+  // (or right after materialize_transport_lines()),
+  // otherwise the items live in the transport line the conveyor is part of
+  std::array<ConveyorItem, CONVEYOR_THROUGHPUT> items{};
 };
 static_assert(Rotatable<Conveyor>);
+static_assert(std::is_trivially_copyable_v<Conveyor>);
 
 struct Item {
   static constexpr vec2 DIMS = {1, 1};
@@ -173,8 +240,10 @@ struct WorldTunnel {
   };
   static constexpr f32 OUTPUT_RATE = 5;
   f32 item_output_accumulator{};
+  // NOTE: cached by update_neighbours()
+  OutputNeighbours<4> output_neighbours{};
 
-  std::vector<ItemSlot> inventory = {
+  Inventory<8> inventory = {{
     {.flags = ITEM_SLOT_FLAGS_INPUT},
     {.flags = ITEM_SLOT_FLAGS_INPUT},
     {.flags = ITEM_SLOT_FLAGS_INPUT},
@@ -182,17 +251,19 @@ struct WorldTunnel {
     {.flags = ITEM_SLOT_FLAGS_OUTPUT},
     {.flags = ITEM_SLOT_FLAGS_OUTPUT},
     {.flags = ITEM_SLOT_FLAGS_OUTPUT},
-    {.flags = ITEM_SLOT_FLAGS_OUTPUT}
-  };
+    {.flags = ITEM_SLOT_FLAGS_OUTPUT},
+  }};
 
   World to{};
 };
 static_assert(OutputsItems<WorldTunnel>);
 static_assert(HasInventory<WorldTunnel>);
+static_assert(std::is_trivially_copyable_v<WorldTunnel>);
 
 template <typename T>
 concept MaintenanceHasMiniGame = requires(
   T& t,
+  Random& random,
   const Input& input,
   f32 dt,
   const AssetManager& assets,
@@ -200,7 +271,7 @@ concept MaintenanceHasMiniGame = requires(
   const vec2& window_offset
 ) {
   t.open;
-  maintenance_init_minigame(t);
+  maintenance_init_minigame(t, random);
   maintenance_update_minigame(t, input, dt);
   maintenance_render_minigame(t, assets, render_texture, window_offset);
 };
@@ -234,7 +305,7 @@ struct MaintenanceLubrication {
   std::vector<LubricationPoint> points{};
 };
 
-void maintenance_init_minigame(MaintenanceLubrication& state);
+void maintenance_init_minigame(MaintenanceLubrication& state, Random& random);
 bool maintenance_update_minigame(MaintenanceLubrication& state, const Input& input, f32 dt);
 void maintenance_render_minigame(
   MaintenanceLubrication& state,
@@ -265,7 +336,7 @@ struct MaintenanceCleaning {
   vec2 last_mouse_pos{};
 };
 
-void maintenance_init_minigame(MaintenanceCleaning& state);
+void maintenance_init_minigame(MaintenanceCleaning& state, Random& random);
 bool maintenance_update_minigame(MaintenanceCleaning& state, const Input& input, f32);
 void maintenance_render_minigame(
   MaintenanceCleaning& state,
@@ -307,7 +378,7 @@ struct MaintenanceComponentReplacement {
   Component fixed{};
 };
 
-void maintenance_init_minigame(MaintenanceComponentReplacement& state);
+void maintenance_init_minigame(MaintenanceComponentReplacement& state, Random& random);
 bool maintenance_update_minigame(MaintenanceComponentReplacement& state, const Input& input, f32);
 void maintenance_render_minigame(
   MaintenanceComponentReplacement& state,
@@ -333,7 +404,7 @@ struct MaintenanceCalibration {
   f32 t{};
 };
 
-void maintenance_init_minigame(MaintenanceCalibration& state);
+void maintenance_init_minigame(MaintenanceCalibration& state, Random& random);
 bool maintenance_update_minigame(MaintenanceCalibration& state, const Input& input, f32 dt);
 void maintenance_render_minigame(
   MaintenanceCalibration& state,
@@ -364,7 +435,7 @@ std::string_view maintenance_name(const Maintenance& maintenance);
 ItemType maintenance_fix_item(const Maintenance& maintenance);
 
 bool* maintenance_is_minigame_open(Maintenance& maintenance);
-void maintenance_init_minigame(Maintenance& maintenance);
+void maintenance_init_minigame(Maintenance& maintenance, Random& random);
 bool maintenance_update_minigame(Maintenance& maintenance, const Input& input, f32 dt);
 void maintenance_render_minigame(
   Maintenance& maintenance,
@@ -435,8 +506,10 @@ struct ResourceMessageReceiver {
   };
   static constexpr f32 OUTPUT_RATE = 5;
   f32 item_output_accumulator{};
+  // NOTE: cached by update_neighbours()
+  OutputNeighbours<3> output_neighbours{};
 
-  std::vector<ItemSlot> inventory = std::vector<ItemSlot>(REQUESTABLE_ITEMS.size());
+  Inventory<REQUESTABLE_ITEMS.size()> inventory{};
 
   // TODO: this is not really needed
   constexpr ResourceMessageReceiver() {
@@ -479,9 +552,10 @@ struct Assembler {
   };
   static constexpr f32 OUTPUT_RATE = 5;
   f32 item_output_accumulator{};
+  // NOTE: cached by update_neighbours()
+  OutputNeighbours<4> output_neighbours{};
 
-  std::vector<ItemSlot> inventory =
-    std::vector<ItemSlot>(Recipe::MAX_INPUT_SLOTS + Recipe::MAX_OUTPUT_SLOTS);
+  Inventory<Recipe::MAX_INPUT_SLOTS + Recipe::MAX_OUTPUT_SLOTS> inventory{};
 
   u32 selected_recipe_idx{};
   f32 t{};
@@ -648,14 +722,42 @@ using EntityData = std::variant<
   ResourceMessageReceiver,
   Assembler>;
 
+static constexpr u32 ENTITY_TYPE_COUNT = std::variant_size_v<EntityData>;
+
+template <u32 Type>
+using EntityTypeAt = std::variant_alternative_t<Type, EntityData>;
+
+// NOTE: index of T inside of EntityData, used as the type tag of stored entities
+template <typename T>
+static constexpr u32 ENTITY_TYPE = []<u32... Types>(std::integer_sequence<u32, Types...>) {
+  u32 type = ENTITY_TYPE_COUNT;
+  ((std::is_same_v<T, EntityTypeAt<Types>> ? (type = Types, true) : false) || ...);
+  return type;
+}(std::make_integer_sequence<u32, ENTITY_TYPE_COUNT>{});
+
+std::string_view entity_type_to_string(u32 type);
+
+// NOTE: an entity that lives in the EntityStore
+// only the hot fields are kept here, the data itself sits in a dense per type array
 struct Entity {
+  EntityId id{};
+  vec2 pos{};
+  World world{};
+  u32 type{};
+  // NOTE: points into EntityPools::data, the pools fix it up whenever the array moves
+  void* data{};
+};
+
+// NOTE: an entity that is not in the EntityStore (yet)
+// used for spawning/placing entities and for saving them
+struct EntityPrototype {
   EntityId id{};
   vec2 pos{};
   World world{};
   EntityData data{};
 };
 
-static const std::array PLACEABLE = std::to_array<Entity>({
+static const std::array PLACEABLE = std::to_array<EntityPrototype>({
   {.data = Block{}},
   {.data = Player{}},
   {.data = Storage{}},
@@ -667,106 +769,438 @@ static const std::array PLACEABLE = std::to_array<Entity>({
 });
 
 struct AddCommand {
-  Entity entity{};
+  EntityPrototype entity{};
 };
 
 struct RemoveCommand {
   EntityId id{};
 };
 
-using Command = std::variant<AddCommand, RemoveCommand>;
+// NOTE: the add commands live in a per tick arena (they hold whole entities), reset by flush()
+// everything adds and removes in a tick just reuses the same memory
+struct CommandBuffer {
+  Arena arena{};
+  std::vector<AddCommand*> adds{};
+  std::vector<RemoveCommand> removes{};
+
+  CommandBuffer() = default;
+  CommandBuffer(CommandBuffer&&) = default;
+  CommandBuffer& operator=(CommandBuffer&&) = default;
+
+  // NOTE: the arena cant be copied, but there is never a reason to copy pending commands anyway
+  CommandBuffer(const CommandBuffer& other) {
+    ASSERT(other.adds.empty() && other.removes.empty(), "copying pending commands");
+  }
+  CommandBuffer& operator=(const CommandBuffer& other) {
+    ASSERT(other.adds.empty() && other.removes.empty(), "copying pending commands");
+    for (auto* cmd : adds) {
+      std::destroy_at(cmd);
+    }
+    adds.clear();
+    removes.clear();
+    arena_reset(arena);
+    return *this;
+  }
+};
+
+static constexpr i32 CHUNK_SHIFT = 5;
+static constexpr i32 CHUNK_SIZE  = 1 << CHUNK_SHIFT;
+
+// NOTE: CHUNK_SIZE x CHUNK_SIZE tiles of a single world
+struct WorldChunk {
+  // NOTE: every entity that covers the tile
+  // (entities bigger than a single tile are put into all of the tiles they cover)
+  std::array<std::vector<EntityId>, CHUNK_SIZE * CHUNK_SIZE> tiles{};
+  // NOTE: entities whose pos is inside of the chunk, grouped by type
+  std::array<std::vector<EntityId>, ENTITY_TYPE_COUNT> entities{};
+  // NOTE: the chunk gets freed once nothing covers any of its tiles
+  u32 tile_entries{};
+};
+
+// NOTE: chunks of a single world, keyed by the chunk coordinates
+struct SpatialIndex {
+  std::unordered_map<u64, WorldChunk> chunks{};
+};
+
+template <typename Variant>
+struct EntityDataArrays;
+
+template <typename... Ts>
+struct EntityDataArrays<std::variant<Ts...>> {
+  using Type = std::tuple<std::vector<Ts>...>;
+};
+
+// NOTE: dense per type storage, entities[type][i] is the header of std::get<type>(data)[i]
+// removing swaps the last entity of the type into the hole, so the order is not stable
+struct EntityPools {
+  std::array<std::vector<Entity>, ENTITY_TYPE_COUNT> entities{};
+  EntityDataArrays<EntityData>::Type data{};
+
+  EntityPools() = default;
+  // NOTE: copying has to point the headers at the new data arrays
+  EntityPools(const EntityPools& other);
+  EntityPools& operator=(const EntityPools& other);
+  EntityPools(EntityPools&& other)            = default;
+  EntityPools& operator=(EntityPools&& other) = default;
+};
+
+// NOTE: pools smaller than this never get shrunk, so small factories dont keep reallocating
+static constexpr u64 POOL_SHRINK_MIN_CAPACITY = 256;
+
+// NOTE: where a live entity sits inside of EntityPools
+struct EntityLocation {
+  EntityId id{};
+  u32 type{};
+  u32 idx{};
+};
+
+struct TransportLineItem {
+  ItemSlot slot{};
+  // NOTE: distance to the next item downstream, or to the end of the line for the head item
+  f32 gap{};
+};
+
+// NOTE: a whole chain of linked conveyors simulated as one belt
+// items only store the gaps between each other, so a moving line only changes a single gap per tick
+struct TransportLine {
+  // NOTE: dense conveyor indices, starting at the head of the line going upstream
+  // (empty once the line got taken apart, until it gets reused)
+  std::vector<u32> conveyors{};
+  // NOTE: ordered from the head to the tail, so pushing onto the tail is a push_back
+  // the items before items_head were handed off already (see transport_line_items())
+  std::vector<TransportLineItem> items{};
+  u32 items_head{};
+  // NOTE: free space between the start of the line and the tail item
+  f32 entry_gap{};
+  // NOTE: how many items at the head are closed up and cant move until the head gets handed off,
+  // so moving a line that backed up doesnt walk over all of them every tick
+  u32 stuck_items{};
+  // NOTE: the head conveyor feeds back into the tail one
+  bool looped{};
+  // NOTE: linked conveyors are always in the same world
+  World world{};
+
+  // NOTE: asleep once nothing on it can move, until something calls wake() on the line
+  bool active{};
+  // NOTE: what the head conveyor hands its items off to
+  EntityId target{};
+  u32 next_line_by_target{};
+};
+
+static constexpr u32 NULL_TRANSPORT_LINE = std::numeric_limits<u32>::max();
+
+struct ConveyorNode {
+  // NOTE: NULL_TRANSPORT_LINE while the conveyor isnt part of a line
+  u32 line_idx = NULL_TRANSPORT_LINE;
+  // NOTE: how many conveyors away from the head of the line
+  u32 line_tile{};
+};
+
+// NOTE: conveyors linked from -> to (both have to point at each other)
+// every conveyor has at most one upstream and one downstream link,
+// so the graph is just a bunch of chains and cycles, each of which becomes one transport line
+struct ConveyorGraph {
+  // NOTE: while dirty the items stored in the conveyors themselves are the real ones,
+  // otherwise the transport lines own them (see materialize_transport_lines()),
+  // only a loaded store is dirty, every change after that only takes apart the lines it touches
+  bool dirty = true;
+  std::vector<TransportLine> lines{};
+  // NOTE: split by world, so every world can be simulated on its own
+  std::array<std::vector<u32>, WORLD_COUNT> active_lines{};
+  // NOTE: parallel to active_lines, scratch space of system_move_items() kept around between
+  // ticks, so it doesnt allocate every tick
+  std::array<std::vector<u8>, WORLD_COUNT> keep_awake{};
+  // NOTE: indexed by the dense conveyor index (same as view<Conveyor>)
+  std::vector<ConveyorNode> nodes{};
+  // NOTE: indexed by EntityId::idx - 1 of the target, the rest of the lines with the same target
+  // are linked through TransportLine::next_line_by_target
+  std::vector<u32> first_line_by_target{};
+  // NOTE: lines that got taken apart, reused by the next lines that get built
+  std::vector<u32> free_lines{};
+  // NOTE: conveyors that just got added or whose line got taken apart,
+  // update_conveyor_graph() builds the lines they are part of (and only those)
+  std::vector<EntityId> loose_conveyors{};
+};
+
+enum ActivityType {
+  ACTIVITY_RECIPES,
+  ACTIVITY_OUTPUT,
+
+  ACTIVITY_COUNT,
+};
+
+// NOTE: the entities of a single type that might still make progress in a system,
+// the rest are asleep until something calls wake() on them
+struct ActivitySet {
+  std::vector<EntityId> active{};
+  // NOTE: indexed by EntityId::idx - 1, holds the id that is in active
+  // (so an entity reusing the idx of a removed one doesnt look awake)
+  std::vector<EntityId> sparse{};
+};
+
+static constexpr u32 EVENT_CHANNEL_CAPACITY = 64;
+
+// NOTE: ring buffer holding the events of a single type,
+// only ever allocates again if more than its capacity get emitted in a single tick
+template <typename T>
+struct EventChannel {
+  // NOTE: the size is always a power of two
+  std::vector<T> buffer = std::vector<T>(EVENT_CHANNEL_CAPACITY);
+  u32 head{};
+  u32 count{};
+
+  struct Iterator {
+    EventChannel* channel{};
+    u32 idx{};
+
+    Iterator& operator++() {
+      ++idx;
+      return *this;
+    }
+
+    T& operator*() {
+      return channel->buffer[(channel->head + idx) & (channel->buffer.size() - 1)];
+    }
+
+    bool operator!=(const Iterator& other) const {
+      return idx != other.idx;
+    }
+  };
+
+  Iterator begin() {
+    return {.channel = this, .idx = 0};
+  }
+
+  Iterator end() {
+    return {.channel = this, .idx = count};
+  }
+};
+
+// NOTE: has to be in the same order as EventType
+using EventChannels = std::tuple<EventChannel<PlayerCollidedEvent>>;
+static_assert(std::tuple_size_v<EventChannels> == EVENT_TYPE_COUNT);
 
 struct EntityStore {
   // NOTE: stores which idx is free and what generation it previously had
   std::vector<EntityId> free_slots{};
-  u16 next_entity_idx{};
-  std::vector<Entity> entities{};
-
-  std::vector<Command> command_buffer{};
-  std::vector<Event> event_bus{};
+  u32 next_entity_idx{};
+  // NOTE: sparse handle table indexed by EntityId::idx - 1, the id is null for free slots
+  std::vector<EntityLocation> locations{};
+  EntityPools pools{};
+
+  CommandBuffer command_buffer{};
+  EventChannels event_channels{};
+
+  // NOTE: updated in flush() and set_entity_pos(), never serialized
+  std::array<SpatialIndex, WORLD_COUNT> spatial_index{};
+  // NOTE: never serialized
+  ConveyorGraph conveyor_graph{};
+  // NOTE: never serialized, everything gets woken when it is added
+  // split by world like the active transport lines
+  std::array<std::array<std::array<ActivitySet, ENTITY_TYPE_COUNT>, ACTIVITY_COUNT>, WORLD_COUNT>
+    activity{};
 };
 
+// NOTE: walks every type array one after the other
 struct EntityIterator {
-  Entity* curr{};
-  Entity* end{};
+  std::array<std::vector<Entity>, ENTITY_TYPE_COUNT>* entities{};
+  u32 type{};
+  u32 idx{};
 
   EntityIterator& operator++() {
-    do {
-      ++curr;
-    } while (curr < end && !curr->id);
+    ++idx;
+    while (type < ENTITY_TYPE_COUNT && idx >= (*entities)[type].size()) {
+      ++type;
+      idx = 0;
+    }
     return *this;
   }
 
   Entity& operator*() {
-    return *curr;
+    return (*entities)[type][idx];
   }
 
   bool operator!=(const EntityIterator& other) const {
-    return curr != other.curr;
+    return type != other.type || idx != other.idx;
   }
 };
 
 EntityIterator begin(EntityStore& store);
 EntityIterator end(EntityStore& store);
 
-EntityId add_entity(EntityStore& store, const Entity& entity);
-void remove_entity(EntityStore& store, EntityId id);
-bool contains_entity(EntityStore& store, EntityId id);
-// NOTE: DO NOT save the pointer for longer than a single system!
-// It will break things when the entities vector reallocates
-Entity* get_entity(EntityStore& store, EntityId id);
-Entity* get_entity_at_pos(EntityStore& store, const vec2& pos, World world, const vec2& dims);
-std::vector<Entity*>
-get_entities_at_pos(EntityStore& store, const vec2& pos, World world, const vec2& dims);
-void emit(EntityStore& store, const Event& event);
-
-struct EventView {
-  EventType type{};
-  std::vector<Event>& event_bus;
+template <typename T>
+struct EntityView {
+  std::span<Entity> entities{};
+  std::span<T> data{};
 
   struct Iterator {
-    EventType type{};
-    Event* curr{};
-    Event* end{};
+    Entity* entity{};
+    T* data{};
 
     Iterator& operator++() {
-      do {
-        ++curr;
-      } while (curr < end && curr->type != type);
+      ++entity;
+      ++data;
       return *this;
     }
 
-    Event& operator*() {
-      return *curr;
+    std::tuple<Entity&, T&> operator*() {
+      return {*entity, *data};
     }
 
     bool operator!=(const Iterator& other) const {
-      return curr != other.curr;
+      return entity != other.entity;
     }
   };
 
   Iterator begin() {
-    Iterator iter{
-      .type = type,
-      .curr = event_bus.data(),
-      .end  = event_bus.data() + event_bus.size(),
-    };
-    while (iter.curr < iter.end && iter.curr->type != type) {
-      ++iter.curr;
-    }
-    return iter;
+    return {.entity = entities.data(), .data = data.data()};
   }
 
   Iterator end() {
-    Iterator iter{};
-    iter.curr = iter.end = event_bus.data() + event_bus.size();
-    return iter;
+    return {.entity = entities.data() + entities.size(), .data = data.data() + data.size()};
   }
 };
 
-// NOTE: usage -> for (auto& event : listen(store, type)) { ... }
-inline EventView listen(EntityStore& store, EventType type) {
-  return {.type = type, .event_bus = store.event_bus};
+// NOTE: usage -> for (auto [entity, assembler] : view<Assembler>(store)) { ... }
+// only touches the entities of type T
+template <typename T>
+EntityView<T> view(EntityStore& store) {
+  return {
+    .entities = store.pools.entities[ENTITY_TYPE<T>],
+    .data     = std::get<std::vector<T>>(store.pools.data),
+  };
+}
+
+// NOTE: usage -> for_each_entity_type([&]<typename T>() { ... });
+template <typename Func>
+void for_each_entity_type(Func&& func) {
+  [&]<u32... Types>(std::integer_sequence<u32, Types...>) {
+    (func.template operator()<EntityTypeAt<Types>>(), ...);
+  }(std::make_integer_sequence<u32, ENTITY_TYPE_COUNT>{});
+}
+
+// NOTE: calls func with the data of the entity as its actual type
+template <typename Func>
+decltype(auto) visit(Entity& entity, Func&& func) {
+  return [&]<u32... Types>(std::integer_sequence<u32, Types...>) -> decltype(auto) {
+    using Result  = decltype(func(std::declval<EntityTypeAt<0>&>()));
+    using Visitor = Result (*)(void*, std::remove_reference_t<Func>&);
+    static constexpr std::array<Visitor, ENTITY_TYPE_COUNT> VISITORS = {
+      [](void* data, std::remove_reference_t<Func>& func) -> Result {
+        return func(*static_cast<EntityTypeAt<Types>*>(data));
+      }...,
+    };
+    ASSERT(entity.type < ENTITY_TYPE_COUNT, "invalid entity type: {}", entity.type);
+    return VISITORS[entity.type](entity.data, func);
+  }(std::make_integer_sequence<u32, ENTITY_TYPE_COUNT>{});
+}
+
+template <typename Func>
+decltype(auto) visit(const Entity& entity, Func&& func) {
+  return visit(const_cast<Entity&>(entity), [&](auto& value) -> decltype(auto) {
+    return func(std::as_const(value));
+  });
+}
+
+template <typename Func>
+decltype(auto) visit(EntityPrototype& entity, Func&& func) {
+  return std::visit(func, entity.data);
+}
+
+template <typename Func>
+decltype(auto) visit(const EntityPrototype& entity, Func&& func) {
+  return std::visit(func, entity.data);
+}
+
+// NOTE: the pools are always dense, so iterating costs live entities,
+// only the handle table keeps a slot for every idx that was ever used (free ones get reused)
+struct EntityStoreStats {
+  u32 live{};
+  u32 slots{};
+  u64 pool_capacity{};
+};
+
+EntityStoreStats entity_store_stats(const EntityStore& store);
+
+EntityId add_entity(EntityStore& store, const EntityPrototype& entity);
+// NOTE: keeps the id the entity already has, only meant for loading
+void add_entity_with_id(EntityStore& store, EntityPrototype&& entity);
+void remove_entity(EntityStore& store, EntityId id);
+bool contains_entity(EntityStore& store, EntityId id);
+// NOTE: DO NOT save the pointer for longer than a single system!
+// It will break things when the entity arrays reallocate or get reordered in flush()
+Entity* get_entity(EntityStore& store, EntityId id);
+// NOTE: if multiple entities overlap the area, the one with the lowest idx is returned
+Entity* get_entity_at_pos(EntityStore& store, const vec2& pos, World world, const vec2& dims);
+// NOTE: sorted by idx
+std::vector<Entity*>
+get_entities_at_pos(EntityStore& store, const vec2& pos, World world, const vec2& dims);
+// NOTE: every position/world change of an already flushed entity has to go through here,
+// otherwise the spatial index gets out of sync
+void set_entity_pos(EntityStore& store, Entity& entity, const vec2& pos, World world);
+EntityPrototype entity_prototype(const Entity& entity);
+// NOTE: recomputes the cached neighbours (Conveyor and OutputsItems) of every entity
+// that could have a port on the area, has to be called whenever anything on it changes
+void update_neighbours(EntityStore& store, const vec2& pos, const vec2& dims, World world);
+// NOTE: checks the cached neighbours against a full recompute (only in debug builds)
+void validate_neighbours(EntityStore& store);
+// NOTE: has to be called whenever something changes that might let a sleeping entity
+// make progress again, also wakes the transport lines that hand off into it
+void wake(EntityStore& store, EntityId id);
+void wake_transport_line(ConveyorGraph& graph, u32 line_idx);
+// NOTE: throws away every transport line, they all get rebuilt by update_conveyor_graph()
+void invalidate_conveyor_graph(EntityStore& store);
+// NOTE: writes the items of the line the conveyor is part of back into its conveyors
+// and takes the line apart, has to be called before anything reads the items of a conveyor directly
+void detach_transport_line(EntityStore& store, EntityId conveyor_id);
+// NOTE: rebuilds the transport lines if the graph is dirty,
+// otherwise only builds the lines of the loose conveyors
+void update_conveyor_graph(EntityStore& store);
+// NOTE: writes the items of the transport lines back into their conveyors
+void materialize_transport_lines(EntityStore& store);
+bool transport_line_push(TransportLine& line, const ItemSlot& slot);
+// NOTE: puts the item at the start of the conveyor, which has to be the tail of its line
+// the graph has to be up to date already, it only ever gets rebuilt on the main thread
+bool transport_line_push(EntityStore& store, Entity& conveyor_entity, const ItemSlot& slot);
+// NOTE: handing off the head item only moves items_head, the handed off items get erased
+// once they make up half of the vector, so a pop doesnt shift the whole line every time
+void transport_line_pop(TransportLine& line);
+// NOTE: returns whether anything moved
+bool transport_line_move(TransportLine& line, f32 distance);
+// NOTE: which conveyor of the line a position (measured from the end of the line) falls on,
+// and how far along that conveyor it is (same as ConveyorItem::t)
+std::pair<u32, f32> transport_line_tile(const TransportLine& line, f32 pos);
+// NOTE: the items still on the line, starting at the head
+std::span<TransportLineItem> transport_line_items(TransportLine& line);
+std::span<const TransportLineItem> transport_line_items(const TransportLine& line);
+template <typename T>
+EventChannel<T>& event_channel(EntityStore& store) {
+  static_assert(
+    std::is_same_v<std::tuple_element_t<T::TYPE, EventChannels>, EventChannel<T>>,
+    "event channel is not at the index of its EventType"
+  );
+  return std::get<EventChannel<T>>(store.event_channels);
+}
+
+template <typename T>
+void emit(EntityStore& store, const T& event) {
+  auto& channel = event_channel<T>(store);
+  if (channel.count == channel.buffer.size()) {
+    std::vector<T> grown(channel.buffer.size() * 2);
+    for (u32 i = 0; i < channel.count; ++i) {
+      grown[i] = channel.buffer[(channel.head + i) & (channel.buffer.size() - 1)];
+    }
+    channel.buffer = std::move(grown);
+    channel.head   = 0;
+  }
+  channel.buffer[(channel.head + channel.count) & (channel.buffer.size() - 1)] = event;
+  ++channel.count;
+}
+
+// NOTE: usage -> for (auto& event : listen<PlayerCollidedEvent>(store)) { ... }
+template <typename T>
+EventChannel<T>& listen(EntityStore& store) {
+  return event_channel<T>(store);
 }
 
 void flush(EntityStore& store);
@@ -780,12 +1214,21 @@ bool has_gui(const Entity& entity);
 bool has_inventory(const Entity& entity);
 bool has_maintenance(const Entity& entity);
 std::optional<ItemType> entity_to_item(const Entity& entity);
-std::optional<Entity> entity_from_item(ItemType item);
+std::optional<EntityPrototype> entity_from_item(ItemType item);
 TextureType get_texture_type(const Entity& entity);
+TextureType get_texture_type(const EntityPrototype& entity);
 
 // TODO: better name?
 template <typename T>
 T* get_data(Entity& entity) {
+  if (entity.type != ENTITY_TYPE<T>) {
+    return nullptr;
+  }
+  return static_cast<T*>(entity.data);
+}
+
+template <typename T>
+T* get_data(EntityPrototype& entity) {
   return std::get_if<T>(&entity.data);
 }
 
@@ -807,8 +1250,34 @@ std::tuple<Entity*, T*> get_entity_and_data(EntityStore& store, EntityId id) {
   return {nullptr, nullptr};
 }
 
+// NOTE: usage -> for_each_active<Assembler>(store, world, ACTIVITY_RECIPES, [&](Entity& entity, Assembler& assembler) { ... });
+// func returns whether the entity stays awake
+template <typename T, typename Func>
+void for_each_active(EntityStore& store, World world, ActivityType activity, Func&& func) {
+  auto& set = store.activity[world][activity][ENTITY_TYPE<T>];
+  for (u32 i = 0; i < set.active.size();) {
+    auto id             = set.active[i];
+    auto [entity, data] = get_entity_and_data<T>(store, id);
+    if (entity && data && func(*entity, *data)) {
+      ++i;
+      continue;
+    }
+
+    if (set.sparse[id.idx - 1] == id) {
+      set.sparse[id.idx - 1] = NULL_ENTITY;
+    }
+    set.active[i] = set.active.back();
+    set.active.pop_back();
+  }
+}
+
 template <typename T>
 bool is(const Entity& entity) {
+  return entity.type == ENTITY_TYPE<T>;
+}
+
+template <typename T>
+bool is(const EntityPrototype& entity) {
   return std::holds_alternative<T>(entity.data);
 }
 
@@ -816,15 +1285,17 @@ template <typename T>
 bool is(EntityStore& store, EntityId id) {
   auto* entity = get_entity(store, id);
   if (entity) {
-    return std::holds_alternative<T>(entity->data);
+    return is<T>(*entity);
   }
   return false;
 }
 
 Direction* get_rotation(Entity& entity);
+Direction* get_rotation(EntityPrototype& entity);
 Direction* get_rotation(EntityStore& store, EntityId id);
-std::vector<ItemSlot>* get_inventory(Entity& entity);
-std::vector<ItemSlot>* get_inventory(EntityStore& store, EntityId id);
+// NOTE: both return an empty span if the entity has no inventory
+std::span<ItemSlot> get_inventory(Entity& entity);
+std::span<ItemSlot> get_inventory(EntityStore& store, EntityId id);
 // NOTE: both return a (maintenance, possible_maintenances) tuple
 std::tuple<Maintenance*, std::span<const Maintenance>> get_maintenance(Entity& entity);
 std::tuple<Maintenance*, std::span<const Maintenance>>
@@ -832,12 +1303,14 @@ get_maintenance(EntityStore& store, EntityId id);
 OutputsItemsProperties get_outputs_items_properties(Entity& entity);
 OutputsItemsProperties get_outputs_items_properties(EntityStore& store, EntityId id);
 vec2 get_dims(const Entity& entity);
+vec2 get_dims(const EntityPrototype& entity);
 vec2 get_dims(EntityStore& store, EntityId id);
 
 // TODO: think about what is the real purpose of this function
 template <typename Func>
 void for_each_active_slot(Entity& entity, Func&& func) {
-  std::visit(
+  visit(
+    entity,
     overloaded{
       [&](Player& player) {
         for (auto& slot : player.inventory) {
@@ -877,14 +1350,11 @@ void for_each_active_slot(Entity& entity, Func&& func) {
         // TODO: put the thing here
         ASSERT(false, "TODO");
       }
-    },
-    entity.data
+    }
   );
 }
 
-void render_entities(EntityStore& store, World world, const AssetManager& assets);
-
 vec2 player_actual_pos(Entity& entity);
 bool conveyor_points_to(Entity& entity, const vec2& pos);
 bool conveyor_points_from(Entity& entity, const vec2& pos);
-void set_conveyor_from_direction(EntityStore& store, Entity& conveyor);
+void set_conveyor_from_direction(EntityStore& store, EntityPrototype& conveyor);
@@ -1,5 +1,8 @@
 #include "game.h"
 
+#include <algorithm>
+#include <thread>
+
 #include "raylib.h"
 
 #include "core.h"
@@ -11,9 +14,13 @@
 #include "items.h"
 #include "entity.h"
 #include "systems.h"
+#include "simulation.h"
+#include "render.h"
 #include "gui.h"
 #include "editor.h"
 #include "serialization.h"
+#include "replay.h"
+#include "profiler.h"
 
 void init(State& state) {
   state.frame.window_dims = {1280, 720};
@@ -30,6 +37,8 @@ void init(State& state) {
   load_state_from_file(state, DEFAULT_MAP_FILEPATH);
   std::println("loaded world file from '{}'", DEFAULT_MAP_FILEPATH);
 
+  jobs_init(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
   flush(state.store);
 
   state.camera.zoom = 1.0f;
@@ -44,71 +53,65 @@ void init(State& state) {
   );
 }
 
+// NOTE: replays only cover MODE_GAME ticks on top of one save,
+// so the editor or loading a save end them
+static void stop_replay(State& state) {
+  if (state.replay_recorder) {
+    replay_record_end(*state.replay_recorder, state, REPLAY_FILEPATH);
+    state.replay_recorder.reset();
+  }
+  state.replay.reset();
+}
+
 void update_tick(State& state, f32 dt) {
+  PROFILE_SCOPE("update_tick", PROFILER_ZONE_DETAIL);
+  if (action_state(state.tick_input, ACTION_TOGGLE_DEBUG_RENDERING).pressed()) {
+    state.debug = !state.debug;
+  }
   if (action_state(state.tick_input, ACTION_TOGGLE_EDITOR_MODE).pressed()) {
     if (state.mode == MODE_EDITOR) {
       state.mode = MODE_GAME;
     } else {
       state.mode = MODE_EDITOR;
+      stop_replay(state);
+    }
+  }
+
+  if (action_state(state.tick_input, ACTION_TOGGLE_RECORDING).pressed()) {
+    if (state.replay_recorder) {
+      stop_replay(state);
+    } else if (state.mode == MODE_GAME && !state.replay) {
+      state.replay_recorder.emplace();
+      replay_record_begin(*state.replay_recorder, state);
+      std::println("started recording a replay");
+    }
+  }
+  if (action_state(state.tick_input, ACTION_PLAY_REPLAY).pressed() && !state.replay_recorder) {
+    Replay replay{};
+    if (replay_load(replay, REPLAY_FILEPATH)) {
+      replay_begin(replay, state);
+      state.replay = std::move(replay);
+      state.mode   = MODE_GAME;
+      std::println("playing the replay from '{}'", REPLAY_FILEPATH);
     }
   }
 
   switch (state.mode) {
     case MODE_GAME: {
-      // TODO: i dont think this belongs in a system, but maybe?
-      if (action_state(state.tick_input, ACTION_ROTATE).pressed()) {
-        state.current_place_rotation = next_direction(state.current_place_rotation);
+      if (state.replay) {
+        // NOTE: the live input is ignored while the replay plays
+        if (replay_next_tick(*state.replay, state)) {
+          simulation_tick(state, dt);
+        } else {
+          replay_verify(*state.replay, state);
+          state.replay.reset();
+        }
+      } else {
+        if (state.replay_recorder) {
+          replay_record_tick(*state.replay_recorder, state);
+        }
+        simulation_tick(state, dt);
       }
-
-      system_update_time(state.minutes, state.minutes_accumulator, dt);
-      system_move_player(state.store, state.player_id, state.tick_input, dt);
-      system_open_gui(state.store, state.player_id, state.tick_input, state.frame.mouse_world_pos);
-      system_close_gui(state.store, state.player_id, state.tick_input);
-      system_hand_slot_interactions(
-        state.store,
-        state.player_id,
-        state.frame.hovered_slot,
-        state.tick_input
-      );
-      system_drop_items(
-        state.store,
-        state.player_id,
-        state.tick_input,
-        state.frame.mouse_world_pos
-      );
-      system_place_entity(
-        state.store,
-        state.player_id,
-        state.tick_input,
-        state.frame.mouse_world_pos,
-        state.current_place_rotation
-      );
-      system_remove_entity(
-        state.store,
-        state.player_id,
-        state.tick_input,
-        state.frame.mouse_world_pos
-      );
-      system_pickup_item(state.store, state.player_id);
-      system_output_items(state.store, dt);
-      system_move_items(state.store, dt);
-      system_tunnel_through_worlds(state.store, state.player_id);
-      system_transfer_resource_messages(
-        state.store,
-        state.resource_message_receiver_id,
-        state.resource_message_queue,
-        state.minutes
-      );
-      system_progress_recipes(state.store, dt);
-      system_apply_maintenance(state.store);
-      system_update_maintenance_minigames(state.store, state.tick_input, dt);
-      system_update_camera(
-        state.camera,
-        state.tick_input,
-        state.store,
-        state.player_id,
-        state.frame.window_dims
-      );
     } break;
     case MODE_EDITOR: {
       auto result =
@@ -122,19 +125,33 @@ void update_tick(State& state, f32 dt) {
     } break;
   }
 
-  if (action_state(state.tick_input, ACTION_SERIALIZE).pressed()) {
+  // NOTE: a replayed tick can have these pressed too, but they are not part of the simulation
+  if (!state.replay && action_state(state.tick_input, ACTION_TOGGLE_TRACE).pressed()) {
+    if (profiler_capturing()) {
+      profiler_capture_end();
+    } else {
+      profiler_capture_begin(TRACE_FILEPATH);
+    }
+  }
+  if (action_state(state.tick_input, ACTION_WRITE_MEMORY_REPORT).pressed()) {
+    memory_report_write(memory_report(state), MEMORY_REPORT_FILEPATH);
+  }
+  if (!state.replay && action_state(state.tick_input, ACTION_SERIALIZE).pressed()) {
     save_state_to_file(state, SERIALIZATION_MAP_FILEPATH);
   }
-  if (action_state(state.tick_input, ACTION_DESERIALIZE).pressed()) {
+  if (!state.replay && action_state(state.tick_input, ACTION_DESERIALIZE).pressed()) {
+    stop_replay(state);
     load_state_from_file(state, SERIALIZATION_MAP_FILEPATH);
   }
 
+  // NOTE: the editor and loading a save queue up commands too
   flush(state.store);
   clear_event_bus(state.store);
   clear(state.tick_input);
 }
 
 void update_frame(State& state) {
+  PROFILE_SCOPE("update_frame", PROFILER_ZONE_DETAIL);
   state.frame             = {};
   state.frame.window_dims = {f32(GetScreenWidth()), f32(GetScreenHeight())};
   state.frame.mouse_world_pos =
@@ -176,7 +193,7 @@ void update_frame(State& state) {
         state.store,
         state.player_id,
         state.resource_message_queue,
-        state.minutes
+        state.gui_actions
       );
 
       auto receiver_hovered_slot = gui_message_receiver(
@@ -185,7 +202,8 @@ void update_frame(State& state) {
         state.assets,
         state.store,
         state.player_id,
-        state.resource_message_queue
+        state.resource_message_queue,
+        state.gui_actions
       );
       if (receiver_hovered_slot) {
         state.frame.hovered_slot = receiver_hovered_slot;
@@ -196,7 +214,8 @@ void update_frame(State& state) {
         state.maintenance_minigame_texture,
         state.assets,
         state.store,
-        state.player_id
+        state.player_id,
+        state.gui_actions
       );
       if (assembler_hovered_slot) {
         state.frame.hovered_slot = assembler_hovered_slot;
@@ -223,6 +242,7 @@ void update_frame(State& state) {
 }
 
 void render(State& state) {
+  PROFILE_SCOPE("render", PROFILER_ZONE_DETAIL);
   BeginDrawing();
   ClearBackground(WHITE);
 
@@ -355,10 +375,27 @@ void render(State& state) {
   );
   DrawText(time_str.c_str(), 5, 25, 20, DARKGREEN);
   DrawFPS(5, 5);
+  if (state.debug) {
+    auto stats     = entity_store_stats(state.store);
+    auto stats_str = std::format(
+      "ENTITIES: {}/{} slots ({:.0f}% filled), pool capacity {}",
+      stats.live,
+      stats.slots,
+      stats.slots ? 100.0f * f32(stats.live) / f32(stats.slots) : 100.0f,
+      stats.pool_capacity
+    );
+    DrawText(stats_str.c_str(), 5, 45, 20, DARKGREEN);
+    render_memory_report(memory_report(state), {5, 70});
+    render_profiler(profiler(), state.frame.window_dims);
+  }
 
   EndDrawing();
 }
 
 void shutdown(State&) {
+  if (profiler_capturing()) {
+    profiler_capture_end();
+  }
+  jobs_shutdown();
   CloseWindow();
 }
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <optional>
 #include <string_view>
+#include <vector>
 
 #include "core.h"
 #include "assets.h"
@@ -8,6 +10,9 @@
 #include "ui.h"
 #include "entity.h"
 #include "editor.h"
+#include "jobs.h"
+#include "replay.h"
+#include "memory.h"
 
 // TODO: when deserializing the std::vector's may get a wrong size,
 // if i serialized them with one and then i change it to something else,
@@ -26,6 +31,9 @@ enum Mode {
 
 static constexpr std::string_view DEFAULT_MAP_FILEPATH       = "default_map.json";
 static constexpr std::string_view SERIALIZATION_MAP_FILEPATH = "save_file.json";
+static constexpr std::string_view REPLAY_FILEPATH            = "replay.bin";
+static constexpr std::string_view TRACE_FILEPATH             = "trace.json";
+static constexpr std::string_view MEMORY_REPORT_FILEPATH     = "memory_report.json";
 
 struct State {
   static constexpr u32 SERIALIZATION_VERSION = 1;
@@ -43,8 +51,13 @@ struct State {
 
   f32 minutes_accumulator{};
   u64 minutes{};
+  // NOTE: ticks of MODE_GAME, every random stream is derived from these two
+  u64 ticks{};
+  u64 random_seed{};
 
   ResourceMessageQueue resource_message_queue{};
+  // NOTE: queued by the gui during the frames, the next MODE_GAME tick applies and clears them
+  std::vector<GuiAction> gui_actions{};
 
   // TODO: should reset when changing the player hand item
   Direction current_place_rotation = DIR_UP;
@@ -59,6 +72,18 @@ struct State {
 
   bool debug{};
 
+  // NOTE: see memory.h
+  u64 json_dom_bytes{};
+  AllocationStats tick_allocations{};
+
+  // NOTE: at most one of these at a time
+  std::optional<ReplayRecorder> replay_recorder{};
+  std::optional<Replay> replay{};
+
+  // NOTE: the systems of MODE_GAME, built on the first tick
+  // (they hold on to a reference of the state)
+  SystemSchedule tick_schedule{};
+
   Editor editor{};
 };
 
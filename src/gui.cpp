@@ -136,13 +136,13 @@ ItemSlotIdx gui_open_inventory(
     return {};
   }
 
-  auto* open_inv = get_inventory(store, player->open_gui);
-  if (!open_inv) {
+  auto open_inv = get_inventory(store, player->open_gui);
+  if (open_inv.empty()) {
     return {};
   }
 
   ui_element_begin(layout, UI_AUTO_ID);
-  auto hovered_slot = gui_inventory(layout, assets, player->open_gui, *open_inv);
+  auto hovered_slot = gui_inventory(layout, assets, player->open_gui, open_inv);
   ui_element_end(
     layout,
     {
@@ -179,8 +179,9 @@ static void maintenance_ui(
   UI_Layout& layout,
   const RenderTexture& render_texture,
   AssetManager& assets,
-  Player& player,
-  Maintenance& maintenance
+  EntityId entity_id,
+  Maintenance& maintenance,
+  std::vector<GuiAction>& actions
 ) {
   auto fix_item       = maintenance_fix_item(maintenance);
   auto* minigame_open = maintenance_is_minigame_open(maintenance);
@@ -231,32 +232,7 @@ static void maintenance_ui(
     ui_element_end(layout, {.layout_direction = UI_LAYOUT_DIRECTION_VERTICAL, .child_gap = 4});
 
     if (fix_clicked) {
-      bool succeeded{};
-      if (player.hand.type == fix_item && player.hand.count >= MAINTENANCE_FIX_ITEM_COUNT) {
-        auto hand_item_info = item_info(player.hand.type);
-        if (hand_item_info.has_durability) {
-          if (hand_item_info.max_damage - player.hand.damage >= MAINTENANCE_FIX_ITEM_DAMAGE) {
-            player.hand.damage += MAINTENANCE_FIX_ITEM_DAMAGE;
-            succeeded = true;
-          }
-        } else {
-          player.hand.count -= MAINTENANCE_FIX_ITEM_COUNT;
-          succeeded = true;
-        }
-      }
-
-      if (succeeded) {
-        auto* minigame_open = maintenance_is_minigame_open(maintenance);
-        if (minigame_open) {
-          *minigame_open = true;
-          // TODO: maybe check if inited in update and init there?
-          maintenance_init_minigame(maintenance);
-        } else {
-          maintenance = std::monostate{};
-        }
-      } else {
-        // TODO: notify the user they dont have the item
-      }
+      actions.push_back({.type = GUI_ACTION_FIX_MAINTENANCE, .entity = entity_id});
     }
   }
 }
@@ -410,7 +386,7 @@ void gui_message_sender(
   EntityStore& store,
   EntityId player_id,
   ResourceMessageQueue& msg_queue,
-  u64 game_time
+  std::vector<GuiAction>& actions
 ) {
   auto* player = get_data<Player>(store, player_id);
   ASSERT_NO_MSG(player);
@@ -422,7 +398,14 @@ void gui_message_sender(
   ui_element_begin(layout, UI_AUTO_ID);
   ui_element_begin(layout, UI_AUTO_ID);
   if (msg_sender->maintenance.index() != 0) {
-    maintenance_ui(layout, render_texture, assets, *player, msg_sender->maintenance);
+    maintenance_ui(
+      layout,
+      render_texture,
+      assets,
+      player->open_gui,
+      msg_sender->maintenance,
+      actions
+    );
   } else {
     switch (msg_sender->page) {
       case SENDER_PAGE_DISPLAY: {
@@ -430,13 +413,12 @@ void gui_message_sender(
 
         ui_element_begin(layout, UI_AUTO_ID);
         {
-          for (u32 i = 0; i < msg_queue.msgs.size();) {
+          for (u32 i = 0; i < msg_queue.msgs.size(); ++i) {
             bool cancel_clicked = message_ui(layout, assets, msg_queue.msgs[i], i + 1);
-
             if (cancel_clicked) {
-              remove_resource_message(msg_queue, i);
-            } else {
-              ++i;
+              actions.push_back(
+                {.type = GUI_ACTION_CANCEL_MESSAGE, .entity = player->open_gui, .idx = i}
+              );
             }
           }
         }
@@ -448,7 +430,11 @@ void gui_message_sender(
         );
 
         if (switch_page_clicked) {
-          msg_sender->page = SENDER_PAGE_CREATE;
+          actions.push_back(
+            {.type   = GUI_ACTION_SWITCH_SENDER_PAGE,
+             .entity = player->open_gui,
+             .idx    = SENDER_PAGE_CREATE}
+          );
         }
       } break;
 
@@ -523,12 +509,15 @@ void gui_message_sender(
             }
             ui_element_end(layout, {.sizing = {ui_sizing_fill(), ui_sizing_fit()}});
 
-            if (add_clicked && msg.requested_items[i] < item_info(requestable_item).max_count) {
-              msg.requested_items[i] += REQUESTED_ITEMS_MULTIPLE;
+            if (add_clicked) {
+              actions.push_back(
+                {.type = GUI_ACTION_ADD_REQUESTED_ITEM, .entity = player->open_gui, .idx = i}
+              );
             }
-
-            if (remove_clicked && msg.requested_items[i] > 0) {
-              msg.requested_items[i] -= REQUESTED_ITEMS_MULTIPLE;
+            if (remove_clicked) {
+              actions.push_back(
+                {.type = GUI_ACTION_REMOVE_REQUESTED_ITEM, .entity = player->open_gui, .idx = i}
+              );
             }
           }
 
@@ -554,21 +543,14 @@ void gui_message_sender(
         );
 
         if (switch_page_clicked) {
-          msg_sender->page = SENDER_PAGE_DISPLAY;
+          actions.push_back(
+            {.type   = GUI_ACTION_SWITCH_SENDER_PAGE,
+             .entity = player->open_gui,
+             .idx    = SENDER_PAGE_DISPLAY}
+          );
         }
-
         if (create_clicked) {
-          bool all_zero = true;
-          for (u32 i = 0; i < ITEM_COUNT; ++i) {
-            if (msg.requested_items[i] > 0) {
-              all_zero = false;
-              break;
-            }
-          }
-          if (!all_zero) {
-            add_resource_message(msg_queue, msg, game_time);
-            msg = {};
-          }
+          actions.push_back({.type = GUI_ACTION_CREATE_MESSAGE, .entity = player->open_gui});
         }
       } break;
     }
@@ -598,7 +580,8 @@ ItemSlotIdx gui_message_receiver(
   AssetManager& assets,
   EntityStore& store,
   EntityId player_id,
-  ResourceMessageQueue& msg_queue
+  ResourceMessageQueue& msg_queue,
+  std::vector<GuiAction>& actions
 ) {
   auto player = get_data<Player>(store, player_id);
   ASSERT_NO_MSG(player);
@@ -611,7 +594,14 @@ ItemSlotIdx gui_message_receiver(
   ui_element_begin(layout, UI_AUTO_ID);
   ui_element_begin(layout, UI_AUTO_ID);
   if (msg_receiver->maintenance.index() != 0) {
-    maintenance_ui(layout, render_texture, assets, *player, msg_receiver->maintenance);
+    maintenance_ui(
+      layout,
+      render_texture,
+      assets,
+      player->open_gui,
+      msg_receiver->maintenance,
+      actions
+    );
   } else {
     message_header_ui(layout, "Message Receiver");
 
@@ -688,7 +678,8 @@ ItemSlotIdx gui_assembler(
   const RenderTexture& render_texture,
   AssetManager& assets,
   EntityStore& store,
-  EntityId player_id
+  EntityId player_id,
+  std::vector<GuiAction>& actions
 ) {
   auto* player = get_data<Player>(store, player_id);
   ASSERT_NO_MSG(player);
@@ -705,7 +696,14 @@ ItemSlotIdx gui_assembler(
   ui_element_begin(layout, UI_AUTO_ID);
   ui_element_begin(layout, UI_AUTO_ID);
   if (assembler->maintenance.index() != 0) {
-    maintenance_ui(layout, render_texture, assets, *player, assembler->maintenance);
+    maintenance_ui(
+      layout,
+      render_texture,
+      assets,
+      player->open_gui,
+      assembler->maintenance,
+      actions
+    );
   } else {
     ui_element_begin(layout, UI_AUTO_ID);
     {
@@ -725,9 +723,9 @@ ItemSlotIdx gui_assembler(
           bool clicked =
             recipe_button_ui(layout, recipe.name, assembler->selected_recipe_idx == idx);
           if (clicked && assembler->selected_recipe_idx != idx) {
-            assembler->selected_recipe_idx = idx;
-            // TODO: pull out to a clear or something function
-            assembler->t = 0;
+            actions.push_back(
+              {.type = GUI_ACTION_SELECT_RECIPE, .entity = player->open_gui, .idx = idx}
+            );
           }
         }
         ui_element_end(
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <span>
+#include <vector>
 
 #include "core.h"
 #include "ui.h"
@@ -33,6 +34,7 @@ void gui_player_hand(
   EntityStore& store,
   EntityId player_id
 );
+// NOTE: the clicks that change the simulation get queued into actions (see GuiAction)
 void gui_message_sender(
   UI_Layout& layout,
   const RenderTexture& render_texture,
@@ -40,7 +42,7 @@ void gui_message_sender(
   EntityStore& store,
   EntityId player_id,
   ResourceMessageQueue& msg_queue,
-  u64 game_time
+  std::vector<GuiAction>& actions
 );
 ItemSlotIdx gui_message_receiver(
   UI_Layout& layout,
@@ -48,12 +50,14 @@ ItemSlotIdx gui_message_receiver(
   AssetManager& assets,
   EntityStore& store,
   EntityId player_id,
-  ResourceMessageQueue& msg_queue
+  ResourceMessageQueue& msg_queue,
+  std::vector<GuiAction>& actions
 );
 ItemSlotIdx gui_assembler(
   UI_Layout& layout,
   const RenderTexture& render_texture,
   AssetManager& assets,
   EntityStore& store,
-  EntityId player_id
+  EntityId player_id,
+  std::vector<GuiAction>& actions
 );
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <print>
+#include <string_view>
+#include <thread>
+
+#include "core.h"
+#include "utils.h"
+#include "game.h"
+#include "entity.h"
+#include "jobs.h"
+#include "serialization.h"
+#include "simulation.h"
+#include "replay.h"
+#include "profiler.h"
+
+// NOTE: runs the simulation without a window as fast as it can, nothing is rendered
+// and there is no input (unless it comes from a replay), so only the factory itself does something
+// usage: game_headless [--trace <trace file>] [save file] [tick count] [output file]
+//        game_headless [--trace <trace file>] --replay <replay file> [output file]
+static constexpr u32 DEFAULT_TICK_COUNT                   = 60 * TPS;
+static constexpr std::string_view DEFAULT_OUTPUT_FILEPATH = "headless_save_file.json";
+
+static void print_ticks_per_second(u32 tick_count, f64 seconds) {
+  std::println(
+    "ran {} ticks in {:.3f}s: {:.1f} ticks/sec ({:.1f}x real time)",
+    tick_count,
+    seconds,
+    f64(tick_count) / seconds,
+    (f64(tick_count) / TPS) / seconds
+  );
+}
+
+static i32 run_replay(std::string_view replay_filepath, std::string_view output_filepath) {
+  Replay replay{};
+  if (!replay_load(replay, replay_filepath)) {
+    return 1;
+  }
+
+  State state = {};
+  replay_begin(replay, state);
+  std::println("loaded replay from '{}'", replay_filepath);
+
+  jobs_init(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+  auto start = std::chrono::steady_clock::now();
+  while (replay_next_tick(replay, state)) {
+    simulation_tick(state, DT);
+  }
+  auto end = std::chrono::steady_clock::now();
+  print_ticks_per_second(replay.tick_count, std::chrono::duration<f64>(end - start).count());
+
+  bool matches = replay_verify(replay, state);
+  save_state_to_file(state, output_filepath);
+  std::println("saved state to '{}'", output_filepath);
+
+  if (profiler_capturing()) {
+    profiler_capture_end();
+  }
+  jobs_shutdown();
+
+  return matches ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  // NOTE: skips over the trace arguments, so the rest of them keep their positions
+  if (argc > 1 && std::string_view(argv[1]) == "--trace") {
+    if (argc < 3) {
+      std::println(stderr, "--trace needs a trace file");
+      return 1;
+    }
+    profiler_capture_begin(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
+
+  if (argc > 1 && std::string_view(argv[1]) == "--replay") {
+    if (argc < 3) {
+      std::println(stderr, "--replay needs a replay file");
+      return 1;
+    }
+    return run_replay(argv[2], argc > 3 ? argv[3] : DEFAULT_OUTPUT_FILEPATH);
+  }
+
+  std::string_view input_filepath  = argc > 1 ? argv[1] : DEFAULT_MAP_FILEPATH;
+  std::string_view output_filepath = argc > 3 ? argv[3] : DEFAULT_OUTPUT_FILEPATH;
+
+  u32 tick_count = DEFAULT_TICK_COUNT;
+  if (argc > 2) {
+    std::string_view arg = argv[2];
+    auto [end, error]    = std::from_chars(arg.data(), arg.data() + arg.size(), tick_count);
+    if (error != std::errc{} || end != arg.data() + arg.size()) {
+      std::println(stderr, "invalid tick count '{}'", arg);
+      return 1;
+    }
+  }
+
+  // NOTE: nlohmann json would throw on a missing file, which just aborts without exceptions
+  if (!std::filesystem::exists(input_filepath)) {
+    std::println(stderr, "world file '{}' doesnt exist", input_filepath);
+    return 1;
+  }
+
+  State state = {};
+  load_state_from_file(state, input_filepath);
+  std::println("loaded world file from '{}'", input_filepath);
+
+  jobs_init(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+  flush(state.store);
+
+  auto start = std::chrono::steady_clock::now();
+  for (u32 tick = 0; tick < tick_count; ++tick) {
+    simulation_tick(state, DT);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  print_ticks_per_second(tick_count, std::chrono::duration<f64>(end - start).count());
+
+  save_state_to_file(state, output_filepath);
+  std::println("saved state to '{}'", output_filepath);
+
+  if (profiler_capturing()) {
+    profiler_capture_end();
+  }
+  jobs_shutdown();
+
+  return 0;
+}
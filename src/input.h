@@ -77,6 +77,7 @@ struct Input {
   i32 mouse_scroll{};
 };
 
+// NOTE: polls raylib, defined in input_raylib.cpp (not part of game_core)
 void gather_input(Input& input);
 void accumulate_input(Input& to, const Input& from);
 void clear(Input& input);
@@ -96,6 +97,12 @@ enum Action {
   ACTION_TOGGLE_DEBUG_RENDERING,
   ACTION_TOGGLE_EDITOR_MODE,
 
+  ACTION_TOGGLE_RECORDING,
+  ACTION_PLAY_REPLAY,
+
+  ACTION_TOGGLE_TRACE,
+  ACTION_WRITE_MEMORY_REPORT,
+
   ACTION_COUNT,
 };
 
@@ -114,6 +121,12 @@ static constexpr std::array<GKey, ACTION_COUNT> KEYMAP = []() {
 
   map[ACTION_TOGGLE_DEBUG_RENDERING] = GKEY_F3;
   map[ACTION_TOGGLE_EDITOR_MODE]     = GKEY_F4;
+
+  map[ACTION_TOGGLE_RECORDING] = GKEY_F5;
+  map[ACTION_PLAY_REPLAY]      = GKEY_F6;
+
+  map[ACTION_TOGGLE_TRACE]        = GKEY_F7;
+  map[ACTION_WRITE_MEMORY_REPORT] = GKEY_F8;
   return map;
 }();
 
@@ -84,6 +84,11 @@ struct ItemSlot {
   }
 };
 
+// NOTE: every inventory has a compile time capacity, so it is stored inline
+// (copying an entity with an inventory doesnt do any heap allocations)
+template <u32 N>
+using Inventory = std::array<ItemSlot, N>;
+
 void assign_slot(ItemSlot& to, const ItemSlot& from);
 void swap_slots(ItemSlot& a, ItemSlot& b);
 void swap_slot_flags(std::span<ItemSlot> inventory);
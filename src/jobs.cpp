@@ -0,0 +1,228 @@
+#include "jobs.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "profiler.h"
+
+struct QueuedJob {
+  Job job{};
+  JobCounter* counter{};
+};
+
+static constexpr u32 JOB_QUEUE_CAPACITY = 256;
+
+// NOTE: the owner pushes and pops at the back, other threads steal from the front
+// a ring buffer that only ever grows, so queueing a job doesnt allocate once it is big enough
+struct JobQueue {
+  std::mutex mutex{};
+  // NOTE: the size is always a power of two
+  std::vector<QueuedJob> jobs = std::vector<QueuedJob>(JOB_QUEUE_CAPACITY);
+  u32 head{};
+  u32 count{};
+
+  QueuedJob& operator[](u32 idx) {
+    return jobs[(head + idx) & (jobs.size() - 1)];
+  }
+};
+
+struct JobSystem {
+  // NOTE: queue 0 belongs to the main thread, the rest to one worker each
+  std::vector<std::unique_ptr<JobQueue>> queues = [] {
+    std::vector<std::unique_ptr<JobQueue>> queues{};
+    queues.push_back(std::make_unique<JobQueue>());
+    return queues;
+  }();
+  std::atomic<u32> queued{};
+  std::mutex sleep_mutex{};
+  std::condition_variable_any sleep_cv{};
+  // NOTE: has to be after everything the workers use, so they get joined first
+  std::vector<std::jthread> workers{};
+};
+
+static JobSystem& job_system() {
+  static JobSystem system{};
+  return system;
+}
+
+static thread_local u32 t_queue_idx = 0;
+
+static bool job_pop(JobSystem& system, QueuedJob& out) {
+  auto& own = *system.queues[t_queue_idx];
+  {
+    std::scoped_lock lock{own.mutex};
+    if (own.count > 0) {
+      out = own[--own.count];
+      system.queued.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+
+  for (u32 i = 1; i < system.queues.size(); ++i) {
+    auto& other = *system.queues[(t_queue_idx + i) % system.queues.size()];
+    std::scoped_lock lock{other.mutex};
+    if (other.count > 0) {
+      out         = other[0];
+      other.head  = (other.head + 1) & (other.jobs.size() - 1);
+      other.count -= 1;
+      system.queued.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool job_run_one(JobSystem& system) {
+  QueuedJob queued{};
+  if (!job_pop(system, queued)) {
+    return false;
+  }
+  queued.job.run(queued.job.captures.data());
+  if (queued.counter->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // NOTE: taking the lock, so the waiting thread cant miss the wakeup between checking and
+    // going to sleep, the counter might be gone as soon as it sees it at 0
+    std::scoped_lock lock{system.sleep_mutex};
+    system.sleep_cv.notify_all();
+  }
+  return true;
+}
+
+static void job_worker(std::stop_token stop, u32 queue_idx) {
+  auto& system = job_system();
+  t_queue_idx  = queue_idx;
+  while (!stop.stop_requested()) {
+    if (job_run_one(system)) {
+      continue;
+    }
+    std::unique_lock lock{system.sleep_mutex};
+    system.sleep_cv.wait(lock, stop, [&] {
+      return system.queued.load(std::memory_order_relaxed) > 0;
+    });
+  }
+}
+
+void jobs_init(u32 worker_count) {
+  auto& system = job_system();
+  ASSERT(system.workers.empty(), "the job system is already running");
+  for (u32 i = 0; i < worker_count; ++i) {
+    system.queues.push_back(std::make_unique<JobQueue>());
+  }
+  for (u32 i = 0; i < worker_count; ++i) {
+    system.workers.emplace_back(job_worker, i + 1);
+  }
+}
+
+void jobs_shutdown() {
+  auto& system = job_system();
+  for (auto& worker : system.workers) {
+    worker.request_stop();
+  }
+  system.workers.clear();
+  system.queues.resize(1);
+}
+
+u32 job_thread_count() {
+  return job_system().workers.size() + 1;
+}
+
+void job_push(JobCounter& counter, const Job& job) {
+  auto& system = job_system();
+  counter.remaining.fetch_add(1, std::memory_order_relaxed);
+  {
+    auto& own = *system.queues[t_queue_idx];
+    std::scoped_lock lock{own.mutex};
+    if (own.count == own.jobs.size()) {
+      // NOTE: unrolls the ring buffer into a twice as big one
+      std::vector<QueuedJob> jobs(own.jobs.size() * 2);
+      for (u32 i = 0; i < own.count; ++i) {
+        jobs[i] = own[i];
+      }
+      own.jobs = std::move(jobs);
+      own.head = 0;
+    }
+    own[own.count++] = {.job = job, .counter = &counter};
+  }
+  {
+    // NOTE: taking the lock, so a worker cant miss the wakeup between checking and going to sleep
+    std::scoped_lock lock{system.sleep_mutex};
+    system.queued.fetch_add(1, std::memory_order_relaxed);
+  }
+  system.sleep_cv.notify_one();
+}
+
+void job_wait(JobCounter& counter) {
+  auto& system = job_system();
+  while (counter.remaining.load(std::memory_order_acquire) > 0) {
+    if (job_run_one(system)) {
+      continue;
+    }
+    // NOTE: the rest of the jobs are running on other threads
+    std::unique_lock lock{system.sleep_mutex};
+    system.sleep_cv.wait(lock, [&] {
+      return counter.remaining.load(std::memory_order_acquire) == 0 ||
+             system.queued.load(std::memory_order_relaxed) > 0;
+    });
+  }
+}
+
+void schedule_add(SystemSchedule& schedule, ScheduledSystem system) {
+  schedule.systems.push_back(std::move(system));
+}
+
+void schedule_build(SystemSchedule& schedule) {
+  u32 count = schedule.systems.size();
+  schedule.dependents.assign(count, {});
+  schedule.dependency_counts.assign(count, 0);
+  schedule.pending = std::make_unique<std::atomic<u32>[]>(count);
+  schedule.profiler_zones.clear();
+  for (auto& system : schedule.systems) {
+    schedule.profiler_zones.push_back(profiler_zone(system.name, PROFILER_ZONE_SYSTEM));
+  }
+
+  for (u32 j = 0; j < count; ++j) {
+    auto& later = schedule.systems[j];
+    for (u32 i = 0; i < j; ++i) {
+      auto& earlier = schedule.systems[i];
+      if ((earlier.writes & (later.reads | later.writes)) || (later.writes & earlier.reads)) {
+        schedule.dependents[i].push_back(j);
+        ++schedule.dependency_counts[j];
+      }
+    }
+  }
+}
+
+static void schedule_run_system(SystemSchedule& schedule, JobCounter& counter, f32 dt, u32 idx) {
+  {
+    ProfilerScope scope = {.zone = schedule.profiler_zones[idx]};
+    schedule.systems[idx].run(dt);
+  }
+  for (auto dependent : schedule.dependents[idx]) {
+    if (schedule.pending[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      job_push(counter, [&schedule, &counter, dt, dependent] {
+        schedule_run_system(schedule, counter, dt, dependent);
+      });
+    }
+  }
+}
+
+void schedule_run(SystemSchedule& schedule, f32 dt) {
+  ASSERT(schedule.pending, "schedule_build() has to be called before running the schedule");
+  u32 count = schedule.systems.size();
+  for (u32 i = 0; i < count; ++i) {
+    schedule.pending[i].store(schedule.dependency_counts[i], std::memory_order_relaxed);
+  }
+
+  JobCounter counter{};
+  // NOTE: pushed in reverse, so the thread that runs its own queue from the back
+  // picks them up in the serial order
+  for (u32 i = count; i-- > 0;) {
+    if (schedule.dependency_counts[i] == 0) {
+      job_push(counter, [&schedule, &counter, dt, i] {
+        schedule_run_system(schedule, counter, dt, i);
+      });
+    }
+  }
+  job_wait(counter);
+}
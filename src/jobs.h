@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "core.h"
+
+// NOTE: a function pointer with the captures of the job stored inline,
+// so pushing a job never allocates, see job_push()
+struct Job {
+  static constexpr u32 CAPTURE_SIZE = 48;
+
+  void (*run)(void* captures){};
+  alignas(std::max_align_t) std::array<std::byte, CAPTURE_SIZE> captures{};
+};
+
+// NOTE: how many pushed jobs havent finished yet, see job_wait()
+struct JobCounter {
+  std::atomic<u32> remaining{};
+};
+
+// NOTE: without workers every job just runs on the thread that waits for it
+void jobs_init(u32 worker_count);
+void jobs_shutdown();
+// NOTE: the workers and the thread that waits, so how many jobs can run at the same time
+u32 job_thread_count();
+void job_push(JobCounter& counter, const Job& job);
+// NOTE: keeps running queued jobs while waiting, so it is fine to call from inside of a job,
+// once there is nothing left to run it sleeps until the jobs are done (or more get queued)
+void job_wait(JobCounter& counter);
+
+// NOTE: usage -> job_push(counter, [&state, world] { ... });
+// the lambda gets copied into the job, so it can only capture trivially copyable things
+// (references, pointers, numbers) that fit into Job::CAPTURE_SIZE
+template <typename Func>
+void job_push(JobCounter& counter, const Func& func) {
+  static_assert(sizeof(Func) <= Job::CAPTURE_SIZE, "the captures dont fit into a job");
+  static_assert(alignof(Func) <= alignof(std::max_align_t), "the captures are over aligned");
+  static_assert(std::is_trivially_copyable_v<Func>, "the captures have to be trivially copyable");
+
+  Job job = {
+    .run =
+      [](void* captures) {
+        (*std::launder(static_cast<Func*>(captures)))();
+      },
+  };
+  ::new (job.captures.data()) Func(func);
+  job_push(counter, job);
+}
+
+// NOTE: one bit per thing a system can touch, see SystemResource in systems.h
+using ResourceMask = u64;
+
+struct ScheduledSystem {
+  std::string_view name{};
+  ResourceMask reads{};
+  ResourceMask writes{};
+  std::function<void(f32 dt)> run{};
+};
+
+// NOTE: systems are added in the order they would run in serially,
+// every system waits for all of the earlier ones it conflicts with
+// (one of them writes something the other one touches)
+// so running it gives the same result as running every system one after the other
+struct SystemSchedule {
+  std::vector<ScheduledSystem> systems{};
+  std::vector<std::vector<u32>> dependents{};
+  std::vector<u32> dependency_counts{};
+  std::unique_ptr<std::atomic<u32>[]> pending{};
+  // NOTE: every system is timed as its own PROFILER_ZONE_SYSTEM zone
+  std::vector<u32> profiler_zones{};
+};
+
+void schedule_add(SystemSchedule& schedule, ScheduledSystem system);
+void schedule_build(SystemSchedule& schedule);
+void schedule_run(SystemSchedule& schedule, f32 dt);
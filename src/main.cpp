@@ -1,6 +1,15 @@
+#include <string_view>
+
 #include "game.h"
+#include "profiler.h"
+
+// NOTE: usage: game [--trace [trace file]]
+// --trace captures a trace from the very start, it gets written out when the game closes
+int main(int argc, char** argv) {
+  if (argc > 1 && std::string_view(argv[1]) == "--trace") {
+    profiler_capture_begin(argc > 2 ? argv[2] : TRACE_FILEPATH);
+  }
 
-int main() {
   State state = {};
   init(state);
 
@@ -9,6 +18,9 @@ int main() {
 
   // TODO: replace WindowShouldClose() (a raylib function) to something else?
   while (!WindowShouldClose()) {
+    profiler_frame_begin();
+    PROFILE_SCOPE("frame", PROFILER_ZONE_DETAIL);
+
     f64 new_time   = GetTime();
     f64 frame_time = new_time - current_time;
     current_time   = new_time;
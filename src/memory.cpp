@@ -0,0 +1,286 @@
+#include "memory.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <print>
+#include <tuple>
+#include <variant>
+
+#include "json.hpp"
+
+#include "game.h"
+
+using json = nlohmann::json;
+
+struct AllocationCounters {
+  std::atomic<u64> allocations{};
+  std::atomic<u64> frees{};
+  std::atomic<u64> allocated_bytes{};
+  std::atomic<u64> live_bytes{};
+};
+
+// NOTE: constant initialized, so it is there before the first allocation of any static constructor
+static AllocationCounters allocation_counters{};
+
+#if TRACK_ALLOCATIONS
+// NOTE: every allocation remembers its size in front of it, so deletes know what they free
+static constexpr u64 ALLOCATION_HEADER_SIZE = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+// NOTE: null when malloc fails, the nothrow operator new has to return that as is
+static void* tracked_new(std::size_t size) {
+  // NOTE: the header would make the size wrap around
+  if (size > std::numeric_limits<std::size_t>::max() - ALLOCATION_HEADER_SIZE) {
+    return nullptr;
+  }
+  auto* base = static_cast<std::byte*>(std::malloc(size + ALLOCATION_HEADER_SIZE));
+  if (!base) {
+    return nullptr;
+  }
+  *reinterpret_cast<u64*>(base) = size;
+  allocation_counters.allocations.fetch_add(1, std::memory_order_relaxed);
+  allocation_counters.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  allocation_counters.live_bytes.fetch_add(size, std::memory_order_relaxed);
+  return base + ALLOCATION_HEADER_SIZE;
+}
+
+// NOTE: there is no std::bad_alloc to throw without exceptions,
+// and not ASSERT, printing could allocate again
+static void* tracked_new_or_abort(std::size_t size) {
+  auto* ptr = tracked_new(size);
+  if (!ptr) {
+    std::abort();
+  }
+  return ptr;
+}
+
+static void tracked_delete(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  auto* base = static_cast<std::byte*>(ptr) - ALLOCATION_HEADER_SIZE;
+  u64 size   = *reinterpret_cast<u64*>(base);
+  allocation_counters.frees.fetch_add(1, std::memory_order_relaxed);
+  allocation_counters.live_bytes.fetch_sub(size, std::memory_order_relaxed);
+  std::free(base);
+}
+
+void* operator new(std::size_t size) {
+  return tracked_new_or_abort(size);
+}
+
+void* operator new[](std::size_t size) {
+  return tracked_new_or_abort(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return tracked_new(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return tracked_new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+  tracked_delete(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  tracked_delete(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+  tracked_delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+  tracked_delete(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  tracked_delete(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  tracked_delete(ptr);
+}
+#endif
+
+AllocationStats allocation_stats() {
+  return {
+    .allocations     = allocation_counters.allocations.load(std::memory_order_relaxed),
+    .frees           = allocation_counters.frees.load(std::memory_order_relaxed),
+    .allocated_bytes = allocation_counters.allocated_bytes.load(std::memory_order_relaxed),
+    .live_bytes      = allocation_counters.live_bytes.load(std::memory_order_relaxed),
+  };
+}
+
+AllocationStats allocation_stats_since(const AllocationStats& before) {
+  auto now = allocation_stats();
+  return {
+    .allocations     = now.allocations - before.allocations,
+    .frees           = now.frees - before.frees,
+    .allocated_bytes = now.allocated_bytes - before.allocated_bytes,
+    .live_bytes      = now.live_bytes - before.live_bytes,
+  };
+}
+
+template <typename T>
+static u64 vector_bytes(const std::vector<T>& vector) {
+  return vector.capacity() * sizeof(T);
+}
+
+static u64 arena_bytes(const Arena& arena) {
+  u64 bytes{};
+  for (auto& block : arena.blocks) {
+    bytes += block.size;
+  }
+  return bytes;
+}
+
+// NOTE: the nodes of the standard unordered_maps hold a next pointer and the cached hash
+template <typename Map>
+static u64 unordered_map_bytes(const Map& map) {
+  return (map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*))) +
+         (map.bucket_count() * sizeof(void*));
+}
+
+static void memory_report_store(MemoryReport& report, EntityStore& store) {
+  for_each_entity_type([&]<typename T>() {
+    auto& entities = store.pools.entities[ENTITY_TYPE<T>];
+    auto& data     = std::get<std::vector<T>>(store.pools.data);
+    for (auto& entity : entities) {
+      ++report.live_entities[ENTITY_TYPE<T>][entity.world];
+    }
+    report.pool_bytes[ENTITY_TYPE<T>] = vector_bytes(entities) + vector_bytes(data);
+
+    if constexpr (HasInventory<T>) {
+      report.inventory_bytes += data.size() * sizeof(T::inventory);
+    }
+    if constexpr (std::is_same_v<T, Player>) {
+      report.inventory_bytes += data.size() * sizeof(Player::hand);
+    }
+    if constexpr (std::is_same_v<T, Conveyor>) {
+      report.conveyor_item_bytes += data.size() * sizeof(Conveyor::items);
+    }
+  });
+  report.handle_table_bytes = vector_bytes(store.locations) + vector_bytes(store.free_slots);
+
+  auto& graph = store.conveyor_graph;
+  report.conveyor_graph_bytes = vector_bytes(graph.lines) + vector_bytes(graph.nodes) +
+                                vector_bytes(graph.first_line_by_target) +
+                                vector_bytes(graph.free_lines) +
+                                vector_bytes(graph.loose_conveyors);
+  for (auto& line : graph.lines) {
+    report.conveyor_item_bytes += vector_bytes(line.items);
+    report.conveyor_graph_bytes += vector_bytes(line.conveyors);
+  }
+  for (u32 world = 0; world < WORLD_COUNT; ++world) {
+    report.conveyor_graph_bytes += vector_bytes(graph.active_lines[world]) +
+                                   vector_bytes(graph.keep_awake[world]);
+  }
+
+  for (auto& index : store.spatial_index) {
+    report.spatial_index_bytes += unordered_map_bytes(index.chunks);
+    for (auto& [key, chunk] : index.chunks) {
+      for (auto& tile : chunk.tiles) {
+        report.spatial_index_bytes += vector_bytes(tile);
+      }
+      for (auto& entities : chunk.entities) {
+        report.spatial_index_bytes += vector_bytes(entities);
+      }
+    }
+  }
+
+  for (auto& world : store.activity) {
+    for (auto& activity : world) {
+      for (auto& set : activity) {
+        report.activity_bytes += vector_bytes(set.active) + vector_bytes(set.sparse);
+      }
+    }
+  }
+
+  auto& commands = store.command_buffer;
+  report.command_buffer_bytes = vector_bytes(commands.adds) + vector_bytes(commands.removes) +
+                               arena_bytes(commands.arena);
+
+  std::apply(
+    [&](auto&... channels) {
+      ((report.event_bus_bytes += vector_bytes(channels.buffer)), ...);
+    },
+    store.event_channels
+  );
+}
+
+static void memory_report_ui(MemoryReport& report, const UI_System& system) {
+  report.ui_last_frame_data_bytes = unordered_map_bytes(system.last_frame_data);
+  report.ui_cmds_bytes            = vector_bytes(system.ui_cmds);
+  for (auto& arena : system.frame_arenas) {
+    report.ui_frame_arena_bytes += arena_bytes(arena);
+  }
+}
+
+MemoryReport memory_report(State& state) {
+  MemoryReport report{};
+  memory_report_store(report, state.store);
+  memory_report_ui(report, state.ui_system);
+  report.resource_message_bytes = vector_bytes(state.resource_message_queue.msgs);
+  report.json_dom_bytes         = state.json_dom_bytes;
+  report.allocations            = allocation_stats();
+  report.tick_allocations       = state.tick_allocations;
+  return report;
+}
+
+static json allocation_stats_to_json(const AllocationStats& stats) {
+  return {
+    {"allocations", stats.allocations},
+    {"frees", stats.frees},
+    {"allocated_bytes", stats.allocated_bytes},
+    {"live_bytes", i64(stats.live_bytes)},
+  };
+}
+
+bool memory_report_write(const MemoryReport& report, const std::filesystem::path& filepath) {
+  json entities = json::object();
+  for (u32 type = 0; type < ENTITY_TYPE_COUNT; ++type) {
+    json worlds = json::object();
+    for (u32 world = 0; world < WORLD_COUNT; ++world) {
+      worlds[world_to_string(World(world))] = report.live_entities[type][world];
+    }
+    entities[entity_type_to_string(type)] = {
+      {"live", worlds},
+      {"pool_bytes", report.pool_bytes[type]},
+    };
+  }
+
+  json j = {
+    {"entities", entities},
+    {"handle_table_bytes", report.handle_table_bytes},
+    {"inventory_bytes", report.inventory_bytes},
+    {"conveyor_item_bytes", report.conveyor_item_bytes},
+    {"conveyor_graph_bytes", report.conveyor_graph_bytes},
+    {"spatial_index_bytes", report.spatial_index_bytes},
+    {"activity_bytes", report.activity_bytes},
+    {"command_buffer_bytes", report.command_buffer_bytes},
+    {"event_bus_bytes", report.event_bus_bytes},
+    {"resource_message_bytes", report.resource_message_bytes},
+    {"ui_last_frame_data_bytes", report.ui_last_frame_data_bytes},
+    {"ui_cmds_bytes", report.ui_cmds_bytes},
+    {"ui_frame_arena_bytes", report.ui_frame_arena_bytes},
+    {"json_dom_bytes", report.json_dom_bytes},
+    {"track_allocations", bool(TRACK_ALLOCATIONS)},
+    {"allocations", allocation_stats_to_json(report.allocations)},
+    {"tick_allocations", allocation_stats_to_json(report.tick_allocations)},
+  };
+
+  std::ofstream file{filepath};
+  if (!file) {
+    std::println("couldnt open '{}' to write the memory report to", filepath.string());
+    return false;
+  }
+  file << j.dump(2);
+  std::println("saved the memory report to '{}'", filepath.string());
+  return bool(file);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+
+#include "core.h"
+#include "entity.h"
+
+struct State;
+
+// NOTE: only counted when built with GAME_TRACK_ALLOCATIONS (see CMakeLists.txt),
+// which replaces the global operator new/delete, otherwise everything stays 0,
+// over aligned allocations (std::align_val_t) go around it and are not counted
+struct AllocationStats {
+  u64 allocations{};
+  u64 frees{};
+  u64 allocated_bytes{};
+  u64 live_bytes{};
+};
+
+AllocationStats allocation_stats();
+// NOTE: what happened since before was taken, live_bytes is how much it grew (or shrank)
+AllocationStats allocation_stats_since(const AllocationStats& before);
+
+// NOTE: the bytes are what the containers hold on to (their capacity), not just what is in use
+struct MemoryReport {
+  std::array<std::array<u32, WORLD_COUNT>, ENTITY_TYPE_COUNT> live_entities{};
+  // NOTE: the headers and the data of every entity type
+  std::array<u64, ENTITY_TYPE_COUNT> pool_bytes{};
+  // NOTE: the locations and the free slots
+  u64 handle_table_bytes{};
+  // NOTE: part of pool_bytes, the inventories and player hands inside of the entity data
+  u64 inventory_bytes{};
+  // NOTE: the items inside of the conveyor data (part of pool_bytes) and the transport lines
+  u64 conveyor_item_bytes{};
+  // NOTE: the rest of the conveyor graph
+  u64 conveyor_graph_bytes{};
+  u64 spatial_index_bytes{};
+  u64 activity_bytes{};
+  u64 command_buffer_bytes{};
+  u64 event_bus_bytes{};
+  u64 resource_message_bytes{};
+  u64 ui_last_frame_data_bytes{};
+  u64 ui_cmds_bytes{};
+  // NOTE: the elements, strings and ids of the ui
+  u64 ui_frame_arena_bytes{};
+  // NOTE: roughly what the parsed save took up during the last load, gone after it
+  u64 json_dom_bytes{};
+
+  AllocationStats allocations{};
+  AllocationStats tick_allocations{};
+};
+
+MemoryReport memory_report(State& state);
+bool memory_report_write(const MemoryReport& report, const std::filesystem::path& filepath);
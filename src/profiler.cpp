@@ -0,0 +1,166 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <print>
+#include <vector>
+
+Profiler& profiler() {
+  static Profiler profiler{};
+  return profiler;
+}
+
+u32 profiler_zone(std::string_view name, ProfilerZoneKind kind) {
+  auto& p = profiler();
+  std::scoped_lock lock{p.zones_mutex};
+
+  u32 count = p.zone_count.load(std::memory_order_relaxed);
+  for (u32 i = 0; i < count; ++i) {
+    if (p.zones[i].name == name) {
+      return i;
+    }
+  }
+  ASSERT(count < PROFILER_MAX_ZONES, "too many profiler zones, bump PROFILER_MAX_ZONES");
+  p.zones[count] = {.name = name, .kind = kind};
+  p.zone_count.store(count + 1, std::memory_order_release);
+  return count;
+}
+
+void profiler_frame_begin() {
+  auto& p           = profiler();
+  p.current_frame   = (p.current_frame + 1) % PROFILER_FRAME_COUNT;
+  p.finished_frames = std::min(p.finished_frames + 1, PROFILER_FRAME_COUNT - 1);
+  for (auto& ns : p.frames[p.current_frame].ns) {
+    ns.store(0, std::memory_order_relaxed);
+  }
+}
+
+static thread_local ProfilerThreadEvents* t_events = nullptr;
+
+static ProfilerThreadEvents& profiler_thread_events(Profiler& p) {
+  if (!t_events) {
+    std::scoped_lock lock{p.zones_mutex};
+    p.threads.push_back(std::make_unique<ProfilerThreadEvents>());
+    t_events             = p.threads.back().get();
+    t_events->thread_idx = p.threads.size() - 1;
+  }
+  return *t_events;
+}
+
+void profiler_record(u32 zone, ProfilerTime start, ProfilerTime end) {
+  auto& p = profiler();
+  u64 ns  = std::chrono::nanoseconds(end - start).count();
+  p.frames[p.current_frame].ns[zone].fetch_add(ns, std::memory_order_relaxed);
+
+  // NOTE: scopes that were already running when the capture started are left out
+  if (p.capturing.load(std::memory_order_relaxed) && start >= p.capture_start) {
+    profiler_thread_events(p).events.push_back({
+      .zone     = zone,
+      .start_ns = u64(std::chrono::nanoseconds(start - p.capture_start).count()),
+      .end_ns   = u64(std::chrono::nanoseconds(end - p.capture_start).count()),
+    });
+  }
+}
+
+void profiler_capture_begin(const std::filesystem::path& filepath) {
+  auto& p = profiler();
+  ASSERT(!p.capturing, "already capturing a trace");
+  {
+    std::scoped_lock lock{p.zones_mutex};
+    for (auto& thread : p.threads) {
+      thread->events.clear();
+    }
+  }
+  p.capture_filepath = filepath;
+  p.capture_start    = std::chrono::steady_clock::now();
+  p.capturing.store(true, std::memory_order_relaxed);
+  std::println("started capturing a trace");
+}
+
+bool profiler_capturing() {
+  return profiler().capturing.load(std::memory_order_relaxed);
+}
+
+// NOTE: trace event format, complete ("X") events with the times in microseconds
+bool profiler_capture_end() {
+  auto& p = profiler();
+  ASSERT(p.capturing, "not capturing a trace");
+  p.capturing.store(false, std::memory_order_relaxed);
+
+  std::ofstream file{p.capture_filepath};
+  if (!file) {
+    std::println("couldnt open '{}' to write the trace to", p.capture_filepath.string());
+    return false;
+  }
+
+  std::scoped_lock lock{p.zones_mutex};
+  u64 event_count{};
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  for (auto& thread : p.threads) {
+    file << std::format(
+      "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},"
+      "\"args\":{{\"name\":\"thread {}\"}}}}",
+      first ? "" : ",\n",
+      thread->thread_idx,
+      thread->thread_idx
+    );
+    first = false;
+    for (auto& event : thread->events) {
+      auto& zone = p.zones[event.zone];
+      file << std::format(
+        ",\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},"
+        "\"pid\":0,\"tid\":{}}}",
+        zone.name,
+        zone.kind == PROFILER_ZONE_SYSTEM ? "system" : "detail",
+        f64(event.start_ns) / 1e3,
+        f64(event.end_ns - event.start_ns) / 1e3,
+        thread->thread_idx
+      );
+    }
+    event_count += thread->events.size();
+    thread->events.clear();
+  }
+  file << "\n]}\n";
+
+  std::println(
+    "saved a trace of {} events to '{}'",
+    event_count,
+    p.capture_filepath.string()
+  );
+  return bool(file);
+}
+
+u64 profiler_frame_ns(const Profiler& profiler, u32 frames_ago, u32 zone) {
+  ASSERT(frames_ago < profiler.finished_frames, "frame {} wasnt recorded", frames_ago);
+  u32 frame =
+    (profiler.current_frame + PROFILER_FRAME_COUNT - 1 - frames_ago) % PROFILER_FRAME_COUNT;
+  return profiler.frames[frame].ns[zone].load(std::memory_order_relaxed);
+}
+
+ProfilerZoneStats profiler_zone_stats(const Profiler& profiler, u32 zone) {
+  std::vector<u64> samples{};
+  u64 total{};
+  for (u32 i = 0; i < profiler.finished_frames; ++i) {
+    auto ns = profiler_frame_ns(profiler, i, zone);
+    total += ns;
+    if (ns > 0) {
+      samples.push_back(ns);
+    }
+  }
+
+  ProfilerZoneStats stats = {.frames = u32(samples.size()), .total_ms = f64(total) / 1e6};
+  if (samples.empty()) {
+    return stats;
+  }
+  std::ranges::sort(samples);
+  u64 sum{};
+  for (auto ns : samples) {
+    sum += ns;
+  }
+  stats.min_ms = f64(samples.front()) / 1e6;
+  stats.avg_ms = f64(sum) / f64(samples.size()) / 1e6;
+  stats.p99_ms = f64(samples[(samples.size() - 1) * 99 / 100]) / 1e6;
+  return stats;
+}
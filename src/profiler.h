@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "core.h"
+
+// NOTE: keeps how long every zone took in each of the last PROFILER_FRAME_COUNT frames,
+// a zone that runs more than once in a frame (or on more than one thread at a time) adds up,
+// so it is the cpu time spent in it, not the wall time
+static constexpr u32 PROFILER_FRAME_COUNT = 256;
+static constexpr u32 PROFILER_MAX_ZONES   = 64;
+
+enum ProfilerZoneKind {
+  // NOTE: the systems of a tick and what runs after them, none of them overlap,
+  // so together they make up the whole tick
+  PROFILER_ZONE_SYSTEM,
+  // NOTE: everything else, these can be nested in other zones
+  PROFILER_ZONE_DETAIL,
+};
+
+struct ProfilerZone {
+  std::string_view name{};
+  ProfilerZoneKind kind{};
+};
+
+struct ProfilerFrame {
+  std::array<std::atomic<u64>, PROFILER_MAX_ZONES> ns{};
+};
+
+using ProfilerTime = std::chrono::steady_clock::time_point;
+
+// NOTE: one timed scope of a capture, relative to the start of it
+struct ProfilerEvent {
+  u32 zone{};
+  u64 start_ns{};
+  u64 end_ns{};
+};
+
+// NOTE: only ever pushed to by the thread it belongs to, so recording doesnt need a lock
+struct ProfilerThreadEvents {
+  u32 thread_idx{};
+  std::vector<ProfilerEvent> events{};
+};
+
+struct Profiler {
+  // NOTE: also guards adding threads
+  std::mutex zones_mutex{};
+  std::array<ProfilerZone, PROFILER_MAX_ZONES> zones{};
+  std::atomic<u32> zone_count{};
+
+  std::atomic<bool> capturing{};
+  ProfilerTime capture_start{};
+  std::filesystem::path capture_filepath{};
+  std::vector<std::unique_ptr<ProfilerThreadEvents>> threads{};
+
+  std::array<ProfilerFrame, PROFILER_FRAME_COUNT> frames{};
+  // NOTE: the frame that is being recorded right now
+  u32 current_frame{};
+  // NOTE: how many of the frames before the current one have been recorded
+  u32 finished_frames{};
+};
+
+struct ProfilerZoneStats {
+  // NOTE: only the frames the zone ran in count for these
+  u32 frames{};
+  f64 min_ms{};
+  f64 avg_ms{};
+  f64 p99_ms{};
+  // NOTE: over every finished frame
+  f64 total_ms{};
+};
+
+Profiler& profiler();
+// NOTE: looks up the zone by name and adds it if it doesnt exist yet,
+// the name has to outlive the profiler (a string literal)
+u32 profiler_zone(std::string_view name, ProfilerZoneKind kind);
+// NOTE: has to be called at the start of every frame, while no jobs are running
+void profiler_frame_begin();
+void profiler_record(u32 zone, ProfilerTime start, ProfilerTime end);
+
+// NOTE: while capturing, every timed scope is also kept as an event,
+// ending the capture writes them out as a chrome trace (chrome://tracing or ui.perfetto.dev)
+// both have to be called while no jobs are running
+void profiler_capture_begin(const std::filesystem::path& filepath);
+bool profiler_capture_end();
+bool profiler_capturing();
+
+// NOTE: frames_ago == 0 is the last finished frame
+u64 profiler_frame_ns(const Profiler& profiler, u32 frames_ago, u32 zone);
+ProfilerZoneStats profiler_zone_stats(const Profiler& profiler, u32 zone);
+
+struct ProfilerScope {
+  u32 zone{};
+  ProfilerTime start = std::chrono::steady_clock::now();
+
+  ~ProfilerScope() {
+    profiler_record(zone, start, std::chrono::steady_clock::now());
+  }
+};
+
+#define PROFILE_CONCAT_INTERNAL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INTERNAL(a, b)
+
+// NOTE: times the rest of the enclosing scope, the zone is only looked up the first time
+#define PROFILE_SCOPE(name, kind)                                                                  \
+  static const u32 PROFILE_CONCAT(profile_zone_, __LINE__) = profiler_zone(name, kind);            \
+  ProfilerScope PROFILE_CONCAT(profile_scope_, __LINE__) = {                                       \
+    .zone = PROFILE_CONCAT(profile_zone_, __LINE__)                                                \
+  }
@@ -0,0 +1,507 @@
+#include "render.h"
+
+#include <array>
+#include <format>
+#include <string>
+#include <vector>
+
+#include "raylib.h"
+
+#include "core.h"
+#include "utils.h"
+#include "items.h"
+#include "entity.h"
+#include "profiler.h"
+
+void maintenance_render_minigame(
+  MaintenanceLubrication& state,
+  const AssetManager&,
+  const RenderTexture2D& render_texture,
+  const vec2& window_offset
+) {
+  // TODO: i really really dont like this, dont know how else to do it tho
+  state.window_offset = window_offset;
+
+  BeginTextureMode(render_texture);
+  ClearBackground(BLACK);
+  for (const auto& cog : state.cogwheels) {
+    DrawCircleV(vec2_to_raylib(cog.pos), cog.radius, cog.color);
+  }
+  for (const auto& point : state.points) {
+    Color color = point.color;
+    if (point.progress >= 1.0f) {
+      color = YELLOW;
+    }
+    DrawRectanglePro(
+      rect_from_vec2x2(point.pos, point.dims),
+      vec2_to_raylib(point.dims / 2.0f),
+      0,
+      color
+    );
+  }
+  EndTextureMode();
+}
+
+void maintenance_render_minigame(
+  MaintenanceCleaning& state,
+  const AssetManager&,
+  const RenderTexture2D& render_texture,
+  const vec2& window_offset
+) {
+  state.window_offset = window_offset;
+
+  BeginTextureMode(render_texture);
+  ClearBackground(BLACK);
+  DrawRectangleLinesEx(state.OUTER_RECT, 5, GRAY);
+  DrawCircleV({128, 128}, 20, GRAY);
+  DrawCircleLinesV({128, 128}, 112, GRAY);
+  for (const auto& dirty_rect : state.dirty_rects) {
+    Color color = BROWN;
+    color.a *= (1.0f - dirty_rect.progress);
+    DrawRectanglePro(dirty_rect.area, {}, 0, color);
+  }
+  EndTextureMode();
+}
+
+static void
+render_component(Component& comp, const AssetManager& assets, TextureType texture_type) {
+  auto& texture     = assets.textures[texture_type];
+  auto texture_dims = dims_from_texture(texture);
+  auto source_rect  = rect_from_vec2x2({}, texture_dims);
+  auto dest_rect    = rect_from_vec2x2(comp.pos, comp.DIMS);
+  auto origin       = comp.DIMS * 0.5f;
+  DrawTexturePro(texture, source_rect, dest_rect, vec2_to_raylib(origin), 0, WHITE);
+}
+
+void maintenance_render_minigame(
+  MaintenanceComponentReplacement& state,
+  const AssetManager& assets,
+  const RenderTexture2D& render_texture,
+  const vec2& window_offset
+) {
+  state.window_offset = window_offset;
+
+  BeginTextureMode(render_texture);
+  ClearBackground(BLACK);
+  for (const auto& slot : state.slots) {
+    auto rect   = rect_from_vec2x2(slot.pos, slot.DIMS);
+    auto origin = slot.DIMS * 0.5f;
+    DrawRectanglePro(rect, vec2_to_raylib(origin), 0, LIGHTGRAY);
+  }
+  render_component(state.broken, assets, get_texture_type(state.FIX_ITEM));
+  render_component(state.fixed, assets, get_texture_type(state.FIX_ITEM));
+  EndTextureMode();
+}
+
+// TODO: display the range and the value as a wave
+// the middle of the range would be one displayed wavelength
+// and the value would be the other displayed wavelength
+// amplitude would be constant???
+// and you have to get the value wavelength near the range wavelength
+void maintenance_render_minigame(
+  MaintenanceCalibration& state,
+  const AssetManager&,
+  const RenderTexture2D& render_texture,
+  const vec2& window_offset
+) {
+  state.window_offset = window_offset;
+
+  ASSERT_NO_MSG(
+    state.add_rect.width == state.remove_rect.width &&
+    state.add_rect.height == state.remove_rect.height
+  );
+  vec2 origin     = vec2{state.add_rect.width, state.add_rect.height} / 2.0f;
+  auto value_text = std::format("{}", state.value);
+  auto range_text = std::format("Expected range:\n[{};{}]", state.range_low, state.range_high);
+
+  BeginTextureMode(render_texture);
+  ClearBackground(BLACK);
+  DrawTextPro(
+    GetFontDefault(),
+    range_text.c_str(),
+    {128, 64},
+    MeasureTextEx(GetFontDefault(), range_text.c_str(), 20, 2) / 2.0f,
+    0,
+    20,
+    2,
+    WHITE
+  );
+  DrawTextPro(
+    GetFontDefault(),
+    value_text.c_str(),
+    {128, 128},
+    MeasureTextEx(GetFontDefault(), value_text.c_str(), 20, 2) / 2.0f,
+    0,
+    20,
+    2,
+    WHITE
+  );
+  DrawRectanglePro(state.add_rect, vec2_to_raylib(origin), 0, GREEN);
+  DrawRectanglePro(state.remove_rect, vec2_to_raylib(origin), 0, RED);
+  EndTextureMode();
+}
+
+void maintenance_render_minigame(
+  Maintenance& maintenance,
+  const AssetManager& assets,
+  const RenderTexture2D& render_texture,
+  const vec2& window_offset
+) {
+  std::visit(
+    [&](auto& value) {
+      using T = std::decay_t<decltype(value)>;
+      if constexpr (MaintenanceHasMiniGame<T>) {
+        maintenance_render_minigame(value, assets, render_texture, window_offset);
+      }
+    },
+    maintenance
+  );
+}
+
+static void render_entity(Entity& entity, const AssetManager& assets) {
+  const Texture2D* texture{};
+  if (auto* item = get_data<Item>(entity)) {
+    texture = &assets.textures[get_texture_type(item->slot.type)];
+  } else {
+    texture = &assets.textures[get_texture_type(entity)];
+  }
+  // TODO: this makes rendering item entities even worse
+  vec2 dims = get_dims(entity) * GRID_DIMS;
+  vec2 source_pos{};
+  vec2 source_dims = dims;
+
+  // TODO: probably it would be better to just suck it up, and draw all the variants
+  if (auto* conveyor = get_data<Conveyor>(entity)) {
+    bool is_corner = conveyor->to != opposite_direction(conveyor->rotation);
+    if (is_corner) {
+      bool flip = conveyor->to == next_direction(conveyor->rotation);
+      if (flip) {
+        source_dims.x *= -1;
+      }
+      source_pos = vec2{conveyor->DIMS.x * GRID_DIMS.x, 0};
+    }
+  }
+
+  auto source_rect    = rect_from_vec2x2(source_pos, source_dims);
+  Rectangle dest_rect = {
+    .x      = entity.pos.x * GRID_DIMS.x + (GRID_DIMS.x * 0.5f),
+    .y      = entity.pos.y * GRID_DIMS.y + (GRID_DIMS.y * 0.5f),
+    .width  = dims.x,
+    .height = dims.y,
+  };
+  auto origin = vec2_to_raylib(dims * 0.5f);
+
+  if (is<Player>(entity)) {
+    auto actual_pos = player_actual_pos(entity);
+    dest_rect.x     = actual_pos.x * GRID_DIMS.x + (GRID_DIMS.x * 0.5f);
+    dest_rect.y     = actual_pos.y * GRID_DIMS.y + (GRID_DIMS.y * 0.5f);
+  }
+
+  f32 rotation = 0;
+  if (auto* rot = get_rotation(entity)) {
+    rotation = rotation_degrees(*rot);
+  }
+
+  DrawTexturePro(*texture, source_rect, dest_rect, origin, rotation, WHITE);
+}
+
+static void render_conveyor_item(
+  const Entity& entity,
+  const Conveyor& conveyor,
+  const ItemSlot& slot,
+  f32 item_t,
+  const AssetManager& assets
+) {
+  static constexpr f32 ON_CONVEYOR_SCALE = 0.375f;
+
+  auto& on_texture  = assets.textures[get_texture_type(slot.type)];
+  vec2 on_dims      = dims_from_texture(on_texture);
+  Vector2 on_origin = vec2_to_raylib(on_dims) * 0.5f * ON_CONVEYOR_SCALE;
+
+  auto on_source_rect = rect_from_vec2x2({}, on_dims);
+
+  Rectangle on_dest_rect = {
+    .x      = (entity.pos.x * GRID_DIMS.x) + (GRID_DIMS.x * 0.5f),
+    .y      = (entity.pos.y * GRID_DIMS.y) + (GRID_DIMS.y * 0.5f),
+    .width  = on_dims.x * ON_CONVEYOR_SCALE,
+    .height = on_dims.y * ON_CONVEYOR_SCALE,
+  };
+
+  if (item_t < 0.5f) {
+    f32 t = 0.5f - item_t;
+    on_dest_rect.x += (direction_to_vec2(conveyor.rotation).x * t) * GRID_DIMS.x;
+    on_dest_rect.y += (direction_to_vec2(conveyor.rotation).y * t) * GRID_DIMS.y;
+  } else {
+    f32 t = item_t - 0.5f;
+    on_dest_rect.x += (direction_to_vec2(conveyor.to).x * t) * GRID_DIMS.x;
+    on_dest_rect.y += (direction_to_vec2(conveyor.to).y * t) * GRID_DIMS.y;
+  }
+
+  DrawTexturePro(on_texture, on_source_rect, on_dest_rect, on_origin, 0, WHITE);
+}
+
+static void render_conveyor_items(EntityStore& store, World world, const AssetManager& assets) {
+  auto conveyors = view<Conveyor>(store);
+
+  auto& graph = store.conveyor_graph;
+
+  // NOTE: the conveyors that arent part of a line (yet) hold their own items
+  for (u32 idx = 0; idx < conveyors.entities.size(); ++idx) {
+    auto& entity = conveyors.entities[idx];
+    if (entity.world != world ||
+        (!graph.dirty && graph.nodes[idx].line_idx != NULL_TRANSPORT_LINE)) {
+      continue;
+    }
+    for (auto& item : conveyors.data[idx].items) {
+      if (item.slot) {
+        render_conveyor_item(entity, conveyors.data[idx], item.slot, item.t, assets);
+      }
+    }
+  }
+  if (graph.dirty) {
+    return;
+  }
+
+  for (auto& line : graph.lines) {
+    if (line.conveyors.empty() || line.world != world) {
+      continue;
+    }
+    f32 pos = 0.0f;
+    for (auto& item : transport_line_items(line)) {
+      pos += item.gap;
+      auto [tile, t]    = transport_line_tile(line, pos);
+      auto conveyor_idx = line.conveyors[tile];
+      render_conveyor_item(
+        conveyors.entities[conveyor_idx],
+        conveyors.data[conveyor_idx],
+        item.slot,
+        t,
+        assets
+      );
+    }
+  }
+}
+
+void render_entities(EntityStore& store, World world, const AssetManager& assets) {
+  PROFILE_SCOPE("render_entities", PROFILER_ZONE_DETAIL);
+  // NOTE: players go last, so they are drawn on top of whatever they are standing on
+  auto render_type = [&](u32 type) {
+    for (auto& [key, chunk] : store.spatial_index[world].chunks) {
+      for (auto id : chunk.entities[type]) {
+        auto* entity = get_entity(store, id);
+        ASSERT(entity, "spatial index is out of sync with the entity store");
+        render_entity(*entity, assets);
+      }
+    }
+  };
+  for (u32 type = 0; type < ENTITY_TYPE_COUNT; ++type) {
+    if (type != ENTITY_TYPE<Player>) {
+      render_type(type);
+    }
+  }
+  render_conveyor_items(store, world, assets);
+  render_type(ENTITY_TYPE<Player>);
+}
+
+void system_render(EntityStore& store, EntityId player_id, const AssetManager& assets) {
+  auto* player_entity = get_entity(store, player_id);
+  ASSERT_NO_MSG(player_entity);
+
+  render_entities(store, player_entity->world, assets);
+}
+
+// NOTE: a graph of the recent frames with the systems stacked on top of each other,
+// a bar with the share of the ticks every system has and a table with every zone
+void render_profiler(const Profiler& profiler, const vec2& window_dims) {
+  static constexpr f32 WIDTH        = 480;
+  static constexpr f32 PADDING      = 8;
+  static constexpr f32 GRAPH_HEIGHT = 120;
+  static constexpr f32 BAR_HEIGHT   = 16;
+  static constexpr f32 ROW_HEIGHT   = 14;
+  static constexpr i32 FONT_SIZE    = 10;
+  // NOTE: the budget line sits in the middle of the graph, so going over it is still visible
+  static constexpr f64 BUDGET_MS    = 1000.0 / 60.0;
+  static constexpr f32 GRAPH_MS     = 2 * BUDGET_MS;
+  static constexpr auto COLORS      = std::to_array<Color>({
+    RED,
+    ORANGE,
+    GOLD,
+    LIME,
+    SKYBLUE,
+    VIOLET,
+    PINK,
+    BEIGE,
+    DARKGREEN,
+    BLUE,
+    PURPLE,
+    MAROON,
+    BROWN,
+    MAGENTA,
+    YELLOW,
+    DARKBLUE,
+  });
+
+  u32 zone_count = profiler.zone_count.load(std::memory_order_acquire);
+  std::vector<ProfilerZoneStats> stats(zone_count);
+  f64 systems_total_ms{};
+  for (u32 zone = 0; zone < zone_count; ++zone) {
+    stats[zone] = profiler_zone_stats(profiler, zone);
+    if (profiler.zones[zone].kind == PROFILER_ZONE_SYSTEM) {
+      systems_total_ms += stats[zone].total_ms;
+    }
+  }
+
+  f32 height = (PADDING * 4) + GRAPH_HEIGHT + BAR_HEIGHT + (ROW_HEIGHT * f32(zone_count + 1));
+  vec2 pos   = {window_dims.x - WIDTH - PADDING, PADDING};
+  DrawRectangleRec({pos.x, pos.y, WIDTH, height}, Fade(BLACK, 0.75f));
+
+  f32 inner_width = WIDTH - (PADDING * 2);
+  f32 x           = pos.x + PADDING;
+  f32 y           = pos.y + PADDING;
+
+  // NOTE: graph, the newest frame on the right
+  {
+    f32 frame_width = inner_width / PROFILER_FRAME_COUNT;
+    f32 bottom      = y + GRAPH_HEIGHT;
+    for (u32 frames_ago = 0; frames_ago < profiler.finished_frames; ++frames_ago) {
+      f32 frame_x = x + inner_width - (f32(frames_ago + 1) * frame_width);
+      f32 stacked = 0;
+      for (u32 zone = 0; zone < zone_count && stacked < GRAPH_HEIGHT; ++zone) {
+        if (profiler.zones[zone].kind != PROFILER_ZONE_SYSTEM) {
+          continue;
+        }
+        f64 ms = f64(profiler_frame_ns(profiler, frames_ago, zone)) / 1e6;
+        f32 h  = std::min(f32(ms / GRAPH_MS) * GRAPH_HEIGHT, GRAPH_HEIGHT - stacked);
+        DrawRectangleRec(
+          {frame_x, bottom - stacked - h, frame_width, h},
+          COLORS[zone % COLORS.size()]
+        );
+        stacked += h;
+      }
+    }
+    f32 budget_y = bottom - (f32(BUDGET_MS / GRAPH_MS) * GRAPH_HEIGHT);
+    DrawLineV({x, budget_y}, {x + inner_width, budget_y}, RED);
+    DrawText("16.6 ms", x + 2, budget_y - FONT_SIZE - 2, FONT_SIZE, RED);
+    y = bottom + PADDING;
+  }
+
+  // NOTE: share of the ticks
+  {
+    f32 bar_x = x;
+    for (u32 zone = 0; zone < zone_count && systems_total_ms > 0; ++zone) {
+      if (profiler.zones[zone].kind != PROFILER_ZONE_SYSTEM) {
+        continue;
+      }
+      f32 w = f32(stats[zone].total_ms / systems_total_ms) * inner_width;
+      DrawRectangleRec({bar_x, y, w, BAR_HEIGHT}, COLORS[zone % COLORS.size()]);
+      bar_x += w;
+    }
+    y += BAR_HEIGHT + PADDING;
+  }
+
+  // NOTE: table, the systems first
+  static constexpr f32 SHARE_X = 220;
+  static constexpr f32 MIN_X   = 280;
+  static constexpr f32 AVG_X   = 340;
+  static constexpr f32 P99_X   = 400;
+  DrawText("zone", x + ROW_HEIGHT, y, FONT_SIZE, LIGHTGRAY);
+  DrawText("share", x + SHARE_X, y, FONT_SIZE, LIGHTGRAY);
+  DrawText("min ms", x + MIN_X, y, FONT_SIZE, LIGHTGRAY);
+  DrawText("avg ms", x + AVG_X, y, FONT_SIZE, LIGHTGRAY);
+  DrawText("p99 ms", x + P99_X, y, FONT_SIZE, LIGHTGRAY);
+  y += ROW_HEIGHT;
+
+  for (auto kind : {PROFILER_ZONE_SYSTEM, PROFILER_ZONE_DETAIL}) {
+    for (u32 zone = 0; zone < zone_count; ++zone) {
+      if (profiler.zones[zone].kind != kind) {
+        continue;
+      }
+      auto& zone_stats = stats[zone];
+      if (kind == PROFILER_ZONE_SYSTEM) {
+        DrawRectangleRec(
+          {x, y + 2, ROW_HEIGHT - 4, ROW_HEIGHT - 4},
+          COLORS[zone % COLORS.size()]
+        );
+        f64 share = systems_total_ms > 0 ? 100.0 * zone_stats.total_ms / systems_total_ms : 0.0;
+        DrawText(std::format("{:.1f}%", share).c_str(), x + SHARE_X, y, FONT_SIZE, WHITE);
+      }
+      auto name = std::string(profiler.zones[zone].name);
+      DrawText(name.c_str(), x + ROW_HEIGHT, y, FONT_SIZE, WHITE);
+      DrawText(std::format("{:.3f}", zone_stats.min_ms).c_str(), x + MIN_X, y, FONT_SIZE, WHITE);
+      DrawText(std::format("{:.3f}", zone_stats.avg_ms).c_str(), x + AVG_X, y, FONT_SIZE, WHITE);
+      DrawText(std::format("{:.3f}", zone_stats.p99_ms).c_str(), x + P99_X, y, FONT_SIZE, WHITE);
+      y += ROW_HEIGHT;
+    }
+  }
+}
+
+static std::string format_bytes(u64 bytes) {
+  if (bytes >= 1024 * 1024) {
+    return std::format("{:.2f} MB", f64(bytes) / (1024.0 * 1024.0));
+  }
+  if (bytes >= 1024) {
+    return std::format("{:.1f} KB", f64(bytes) / 1024.0);
+  }
+  return std::format("{} B", bytes);
+}
+
+void render_memory_report(const MemoryReport& report, const vec2& pos) {
+  static constexpr f32 WIDTH      = 360;
+  static constexpr f32 PADDING    = 8;
+  static constexpr f32 ROW_HEIGHT = 14;
+  static constexpr i32 FONT_SIZE  = 10;
+  static constexpr f32 VALUE_X    = 220;
+
+  std::vector<std::pair<std::string, std::string>> rows{};
+  rows.push_back({"entity (main/messaging/storage)", "pool"});
+  for (u32 type = 0; type < ENTITY_TYPE_COUNT; ++type) {
+    auto& live = report.live_entities[type];
+    rows.push_back({
+      std::format(
+        "{} {}/{}/{}",
+        entity_type_to_string(type),
+        live[WORLD_MAIN],
+        live[WORLD_MESSAGING],
+        live[WORLD_STORAGE]
+      ),
+      format_bytes(report.pool_bytes[type]),
+    });
+  }
+  rows.push_back({"handle table", format_bytes(report.handle_table_bytes)});
+  rows.push_back({"inventories (in the pools)", format_bytes(report.inventory_bytes)});
+  rows.push_back({"conveyor items", format_bytes(report.conveyor_item_bytes)});
+  rows.push_back({"conveyor graph", format_bytes(report.conveyor_graph_bytes)});
+  rows.push_back({"spatial index", format_bytes(report.spatial_index_bytes)});
+  rows.push_back({"activity", format_bytes(report.activity_bytes)});
+  rows.push_back({"command buffer", format_bytes(report.command_buffer_bytes)});
+  rows.push_back({"event bus", format_bytes(report.event_bus_bytes)});
+  rows.push_back({"resource messages", format_bytes(report.resource_message_bytes)});
+  rows.push_back({"ui last frame data", format_bytes(report.ui_last_frame_data_bytes)});
+  rows.push_back({"ui commands", format_bytes(report.ui_cmds_bytes)});
+  rows.push_back({"ui frame arenas", format_bytes(report.ui_frame_arena_bytes)});
+  rows.push_back({"json dom (last load)", format_bytes(report.json_dom_bytes)});
+  if (TRACK_ALLOCATIONS) {
+    auto& all  = report.allocations;
+    auto& tick = report.tick_allocations;
+    rows.push_back({"heap live", format_bytes(all.live_bytes)});
+    rows.push_back({
+      std::format("heap total {}/{} allocs/frees", all.allocations, all.frees),
+      format_bytes(all.allocated_bytes),
+    });
+    rows.push_back({
+      std::format("last tick {}/{} allocs/frees", tick.allocations, tick.frees),
+      format_bytes(tick.allocated_bytes),
+    });
+  } else {
+    rows.push_back({"heap", "build with GAME_TRACK_ALLOCATIONS"});
+  }
+
+  f32 height = (PADDING * 2) + (ROW_HEIGHT * f32(rows.size()));
+  DrawRectangleRec({pos.x, pos.y, WIDTH, height}, Fade(BLACK, 0.75f));
+  f32 y = pos.y + PADDING;
+  for (auto& [name, value] : rows) {
+    DrawText(name.c_str(), pos.x + PADDING, y, FONT_SIZE, WHITE);
+    DrawText(value.c_str(), pos.x + VALUE_X, y, FONT_SIZE, WHITE);
+    y += ROW_HEIGHT;
+  }
+}
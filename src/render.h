@@ -0,0 +1,21 @@
+#pragma once
+
+#include "core.h"
+#include "assets.h"
+#include "entity.h"
+#include "profiler.h"
+#include "memory.h"
+
+// NOTE: everything that draws with raylib lives in here (and ui/gui),
+// so the simulation can be built without a window, see game_core in CMakeLists.txt
+// the maintenance minigames are rendered in render.cpp too,
+// but they are declared next to the rest of them in entity.h
+
+void render_entities(EntityStore& store, World world, const AssetManager& assets);
+
+// TODO: remove this, its not really a system (?)
+void system_render(EntityStore& store, EntityId player_id, const AssetManager& assets);
+
+// NOTE: the f3 overlay, draws in screen space so it has to be called outside of BeginMode2D()
+void render_profiler(const Profiler& profiler, const vec2& window_dims);
+void render_memory_report(const MemoryReport& report, const vec2& pos);
@@ -0,0 +1,423 @@
+#include "replay.h"
+
+#include <cstring>
+#include <fstream>
+#include <print>
+#include <span>
+
+#include "json.hpp"
+
+#include "core.h"
+#include "game.h"
+#include "serialization.h"
+
+// NOTE: file layout, everything in the native byte order
+// u32 magic, u32 version, u32 tick count, u64 checksum of the final state,
+// u64 save size, save (json), u64 ticks size, ticks
+static constexpr u32 REPLAY_MAGIC   = 0x4c504552; // "REPL"
+static constexpr u32 REPLAY_VERSION = 2;
+
+enum ReplayTickFlags : u8 {
+  REPLAY_TICK_MOUSE_POS       = 1 << 0,
+  REPLAY_TICK_MOUSE_SCROLL    = 1 << 1,
+  REPLAY_TICK_LMB             = 1 << 2,
+  REPLAY_TICK_RMB             = 1 << 3,
+  REPLAY_TICK_KEYS            = 1 << 4,
+  REPLAY_TICK_MOUSE_WORLD_POS = 1 << 5,
+  REPLAY_TICK_HOVERED_SLOT    = 1 << 6,
+  REPLAY_TICK_GUI_ACTIONS     = 1 << 7,
+
+  REPLAY_TICK_ALL = (1 << 8) - 1,
+};
+
+static void write_varint(std::vector<u8>& out, u64 value) {
+  while (value >= 0x80) {
+    out.push_back(u8(value) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(u8(value));
+}
+
+static void write_vec2(std::vector<u8>& out, const vec2& value) {
+  u8 bytes[sizeof(vec2)]{};
+  std::memcpy(bytes, &value, sizeof(vec2));
+  out.insert(out.end(), std::begin(bytes), std::end(bytes));
+}
+
+// NOTE: the transition count is almost always 0 or 1, so it shares a varint with down
+static void write_key_state(std::vector<u8>& out, const KeyState& state) {
+  write_varint(out, (u64(state.transition_count) << 1) | u64(state.down));
+}
+
+static bool key_state_equal(const KeyState& a, const KeyState& b) {
+  return a.transition_count == b.transition_count && a.down == b.down;
+}
+
+// NOTE: reading past the end of the ticks sets failed, everything read after that is 0
+struct ReplayReader {
+  std::span<const u8> bytes{};
+  u64 cursor{};
+  bool failed{};
+};
+
+static u64 read_varint(ReplayReader& reader) {
+  u64 value{};
+  for (u32 shift = 0; shift < 64; shift += 7) {
+    if (reader.cursor >= reader.bytes.size()) {
+      reader.failed = true;
+      return 0;
+    }
+    u8 byte = reader.bytes[reader.cursor++];
+    value |= u64(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+  }
+  return value;
+}
+
+static vec2 read_vec2(ReplayReader& reader) {
+  if (reader.cursor + sizeof(vec2) > reader.bytes.size()) {
+    reader.failed = true;
+    return {};
+  }
+  vec2 value{};
+  std::memcpy(&value, reader.bytes.data() + reader.cursor, sizeof(vec2));
+  reader.cursor += sizeof(vec2);
+  return value;
+}
+
+static KeyState read_key_state(ReplayReader& reader) {
+  u64 value = read_varint(reader);
+  return {.transition_count = u32(value >> 1), .down = bool(value & 1)};
+}
+
+// NOTE: applies what changed in the next tick on top of tick,
+// returns false if the ticks end in the middle of it or it doesnt make sense
+static bool read_tick(ReplayReader& reader, ReplayTick& tick) {
+  if (reader.cursor >= reader.bytes.size()) {
+    return false;
+  }
+  u8 flags = reader.bytes[reader.cursor++];
+  if (flags & ~REPLAY_TICK_ALL) {
+    return false;
+  }
+  if (flags & REPLAY_TICK_MOUSE_POS) {
+    tick.input.mouse_pos = read_vec2(reader);
+  }
+  if (flags & REPLAY_TICK_MOUSE_SCROLL) {
+    u32 zigzag              = u32(read_varint(reader));
+    tick.input.mouse_scroll = i32(zigzag >> 1) ^ -i32(zigzag & 1);
+  }
+  if (flags & REPLAY_TICK_LMB) {
+    tick.input.lmb = read_key_state(reader);
+  }
+  if (flags & REPLAY_TICK_RMB) {
+    tick.input.rmb = read_key_state(reader);
+  }
+  if (flags & REPLAY_TICK_KEYS) {
+    u64 changed_keys = read_varint(reader);
+    if (changed_keys > GKEY_COUNT) {
+      return false;
+    }
+    for (u64 i = 0; i < changed_keys; ++i) {
+      u64 key = read_varint(reader);
+      if (key >= GKEY_COUNT) {
+        return false;
+      }
+      tick.input.keys[key] = read_key_state(reader);
+    }
+  }
+  if (flags & REPLAY_TICK_MOUSE_WORLD_POS) {
+    tick.mouse_world_pos = read_vec2(reader);
+  }
+  if (flags & REPLAY_TICK_HOVERED_SLOT) {
+    tick.hovered_slot.entity.idx = read_varint(reader);
+    tick.hovered_slot.entity.gen = read_varint(reader);
+    tick.hovered_slot.slot_idx   = u32(read_varint(reader));
+  }
+  tick.gui_actions.clear();
+  if (flags & REPLAY_TICK_GUI_ACTIONS) {
+    // NOTE: every action takes at least 4 bytes, so a corrupt count cant make it allocate much
+    u64 count = read_varint(reader);
+    if (count > (reader.bytes.size() - reader.cursor) / 4) {
+      return false;
+    }
+    for (u64 i = 0; i < count; ++i) {
+      u64 type = read_varint(reader);
+      if (type >= GUI_ACTION_TYPE_COUNT) {
+        return false;
+      }
+      GuiAction action = {.type = GuiActionType(type)};
+      action.entity.idx = read_varint(reader);
+      action.entity.gen = read_varint(reader);
+      action.idx        = u32(read_varint(reader));
+      tick.gui_actions.push_back(action);
+    }
+  }
+  return !reader.failed;
+}
+
+void replay_record_begin(ReplayRecorder& recorder, State& state) {
+  recorder              = {};
+  recorder.initial_save = save_state_to_string(state);
+  load_state_from_string(state, recorder.initial_save);
+  flush(state.store);
+}
+
+void replay_record_tick(ReplayRecorder& recorder, const State& state) {
+  ReplayTick tick = {
+    .input           = state.tick_input,
+    .mouse_world_pos = state.frame.mouse_world_pos,
+    .hovered_slot    = state.frame.hovered_slot,
+    .gui_actions     = state.gui_actions,
+  };
+  auto& last = recorder.last;
+
+  u32 changed_keys{};
+  for (u32 i = 0; i < GKEY_COUNT; ++i) {
+    if (!key_state_equal(tick.input.keys[i], last.input.keys[i])) {
+      ++changed_keys;
+    }
+  }
+
+  u8 flags{};
+  if (tick.input.mouse_pos != last.input.mouse_pos) {
+    flags |= REPLAY_TICK_MOUSE_POS;
+  }
+  if (tick.input.mouse_scroll != last.input.mouse_scroll) {
+    flags |= REPLAY_TICK_MOUSE_SCROLL;
+  }
+  if (!key_state_equal(tick.input.lmb, last.input.lmb)) {
+    flags |= REPLAY_TICK_LMB;
+  }
+  if (!key_state_equal(tick.input.rmb, last.input.rmb)) {
+    flags |= REPLAY_TICK_RMB;
+  }
+  if (changed_keys != 0) {
+    flags |= REPLAY_TICK_KEYS;
+  }
+  if (tick.mouse_world_pos != last.mouse_world_pos) {
+    flags |= REPLAY_TICK_MOUSE_WORLD_POS;
+  }
+  if (tick.hovered_slot.entity != last.hovered_slot.entity ||
+      tick.hovered_slot.slot_idx != last.hovered_slot.slot_idx) {
+    flags |= REPLAY_TICK_HOVERED_SLOT;
+  }
+  if (!tick.gui_actions.empty()) {
+    flags |= REPLAY_TICK_GUI_ACTIONS;
+  }
+
+  auto& out = recorder.ticks;
+  out.push_back(flags);
+  if (flags & REPLAY_TICK_MOUSE_POS) {
+    write_vec2(out, tick.input.mouse_pos);
+  }
+  if (flags & REPLAY_TICK_MOUSE_SCROLL) {
+    // NOTE: zigzag, so small negative values stay small
+    i32 scroll = tick.input.mouse_scroll;
+    write_varint(out, u32(scroll << 1) ^ u32(scroll >> 31));
+  }
+  if (flags & REPLAY_TICK_LMB) {
+    write_key_state(out, tick.input.lmb);
+  }
+  if (flags & REPLAY_TICK_RMB) {
+    write_key_state(out, tick.input.rmb);
+  }
+  if (flags & REPLAY_TICK_KEYS) {
+    write_varint(out, changed_keys);
+    for (u32 i = 0; i < GKEY_COUNT; ++i) {
+      if (!key_state_equal(tick.input.keys[i], last.input.keys[i])) {
+        write_varint(out, i);
+        write_key_state(out, tick.input.keys[i]);
+      }
+    }
+  }
+  if (flags & REPLAY_TICK_MOUSE_WORLD_POS) {
+    write_vec2(out, tick.mouse_world_pos);
+  }
+  if (flags & REPLAY_TICK_HOVERED_SLOT) {
+    write_varint(out, tick.hovered_slot.entity.idx);
+    write_varint(out, tick.hovered_slot.entity.gen);
+    write_varint(out, tick.hovered_slot.slot_idx);
+  }
+  if (flags & REPLAY_TICK_GUI_ACTIONS) {
+    write_varint(out, tick.gui_actions.size());
+    for (auto& action : tick.gui_actions) {
+      write_varint(out, action.type);
+      write_varint(out, action.entity.idx);
+      write_varint(out, action.entity.gen);
+      write_varint(out, action.idx);
+    }
+  }
+
+  last = std::move(tick);
+  ++recorder.tick_count;
+}
+
+template <typename T>
+static void write_value(std::ofstream& file, const T& value) {
+  file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool read_value(std::ifstream& file, T& value) {
+  file.read(reinterpret_cast<char*>(&value), sizeof(T));
+  return bool(file);
+}
+
+bool replay_record_end(
+  ReplayRecorder& recorder,
+  State& state,
+  const std::filesystem::path& filepath
+) {
+  std::ofstream file{filepath, std::ios::binary};
+  if (!file) {
+    std::println("couldnt open '{}' to write the replay to", filepath.string());
+    return false;
+  }
+
+  write_value(file, REPLAY_MAGIC);
+  write_value(file, REPLAY_VERSION);
+  write_value(file, recorder.tick_count);
+  write_value(file, state_checksum(state));
+  write_value(file, u64(recorder.initial_save.size()));
+  file.write(recorder.initial_save.data(), std::streamsize(recorder.initial_save.size()));
+  write_value(file, u64(recorder.ticks.size()));
+  file.write(
+    reinterpret_cast<const char*>(recorder.ticks.data()),
+    std::streamsize(recorder.ticks.size())
+  );
+
+  std::println(
+    "saved a replay of {} ticks ({} bytes of input) to '{}'",
+    recorder.tick_count,
+    recorder.ticks.size(),
+    filepath.string()
+  );
+  return bool(file);
+}
+
+bool replay_load(Replay& replay, const std::filesystem::path& filepath) {
+  replay = {};
+  std::ifstream file{filepath, std::ios::binary};
+  if (!file) {
+    std::println("couldnt open the replay '{}'", filepath.string());
+    return false;
+  }
+
+  // NOTE: the sizes get checked against it, so a corrupt one cant make it allocate whatever it says
+  std::error_code error{};
+  u64 file_size = std::filesystem::file_size(filepath, error);
+  if (error) {
+    std::println("couldnt get the size of the replay '{}'", filepath.string());
+    return false;
+  }
+
+  u32 magic{};
+  u32 version{};
+  if (!read_value(file, magic) || magic != REPLAY_MAGIC) {
+    std::println("'{}' is not a replay", filepath.string());
+    return false;
+  }
+  if (!read_value(file, version)) {
+    std::println("replay '{}' is truncated", filepath.string());
+    return false;
+  }
+  if (version != REPLAY_VERSION) {
+    std::println("replay '{}' has an unsupported version {}", filepath.string(), version);
+    return false;
+  }
+
+  u64 save_size{};
+  u64 ticks_size{};
+  bool ok = read_value(file, replay.tick_count) && read_value(file, replay.checksum) &&
+            read_value(file, save_size) && save_size <= file_size;
+  if (ok) {
+    replay.initial_save.resize(save_size);
+    ok = bool(file.read(replay.initial_save.data(), std::streamsize(save_size)));
+  }
+  ok = ok && read_value(file, ticks_size) && ticks_size <= file_size;
+  if (ok) {
+    replay.ticks.resize(ticks_size);
+    ok = bool(file.read(reinterpret_cast<char*>(replay.ticks.data()), std::streamsize(ticks_size)));
+  }
+  if (!ok) {
+    std::println("replay '{}' is truncated", filepath.string());
+    replay = {};
+    return false;
+  }
+
+  // NOTE: goes through every tick once, so a corrupt replay gets rejected here
+  // instead of aborting in the middle of playing it
+  ReplayReader reader = {.bytes = replay.ticks};
+  ReplayTick tick{};
+  for (u32 i = 0; i < replay.tick_count; ++i) {
+    if (!read_tick(reader, tick)) {
+      std::println("replay '{}' is corrupt at tick {}", filepath.string(), i);
+      replay = {};
+      return false;
+    }
+  }
+  if (reader.cursor != replay.ticks.size()) {
+    std::println(
+      "replay '{}' has {} bytes after its last tick",
+      filepath.string(),
+      replay.ticks.size() - reader.cursor
+    );
+    replay = {};
+    return false;
+  }
+  // NOTE: nlohmann json would throw on a broken save, which just aborts without exceptions
+  if (!nlohmann::json::accept(replay.initial_save)) {
+    std::println("the save that the replay '{}' starts from is corrupt", filepath.string());
+    replay = {};
+    return false;
+  }
+  return true;
+}
+
+void replay_begin(Replay& replay, State& state) {
+  replay.cursor       = 0;
+  replay.current_tick = 0;
+  replay.last         = {};
+  load_state_from_string(state, replay.initial_save);
+  flush(state.store);
+}
+
+bool replay_next_tick(Replay& replay, State& state) {
+  if (replay.current_tick == replay.tick_count) {
+    return false;
+  }
+
+  ReplayReader reader = {.bytes = replay.ticks, .cursor = replay.cursor};
+  auto tick           = replay.last;
+  bool ok             = read_tick(reader, tick);
+  // NOTE: replay_load() already went through every tick
+  ASSERT(ok, "tick {} of the replay is corrupt", replay.current_tick);
+
+  state.tick_input            = tick.input;
+  state.frame.mouse_world_pos = tick.mouse_world_pos;
+  state.frame.hovered_slot    = tick.hovered_slot;
+  state.gui_actions           = tick.gui_actions;
+
+  replay.last   = tick;
+  replay.cursor = reader.cursor;
+  ++replay.current_tick;
+  return true;
+}
+
+bool replay_verify(const Replay& replay, State& state) {
+  auto checksum = state_checksum(state);
+  if (checksum != replay.checksum) {
+    std::println(
+      "replay diverged after {} ticks: expected checksum {:016x}, got {:016x}",
+      replay.current_tick,
+      replay.checksum,
+      checksum
+    );
+    return false;
+  }
+  std::println("replay of {} ticks matches, checksum {:016x}", replay.current_tick, checksum);
+  return true;
+}
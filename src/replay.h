@@ -0,0 +1,66 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "core.h"
+#include "math.h"
+#include "input.h"
+#include "entity.h"
+
+struct State;
+
+// NOTE: a replay is the save the recording started from, and for every MODE_GAME tick after it
+// everything from outside of the simulation that the systems read,
+// stored as what changed since the tick before (an idle tick is a single byte)
+// the seed and the tick count are part of the save, so the random streams line up too
+// gui clicks only queue GuiActions during the frame, which the tick applies, so they are recorded
+// with the tick like the input
+
+// NOTE: what a single tick reads from outside of the simulation
+struct ReplayTick {
+  Input input{};
+  vec2 mouse_world_pos{};
+  ItemSlotIdx hovered_slot{};
+  // NOTE: not delta encoded, every tick has its own
+  std::vector<GuiAction> gui_actions{};
+};
+
+struct ReplayRecorder {
+  std::string initial_save{};
+  std::vector<u8> ticks{};
+  u32 tick_count{};
+  ReplayTick last{};
+};
+
+struct Replay {
+  std::string initial_save{};
+  std::vector<u8> ticks{};
+  u32 tick_count{};
+  u64 checksum{};
+
+  // NOTE: playback
+  u64 cursor{};
+  u32 current_tick{};
+  ReplayTick last{};
+};
+
+// NOTE: reloads the state from the save it writes out,
+// so the live game continues from exactly what the replay will start from
+void replay_record_begin(ReplayRecorder& recorder, State& state);
+// NOTE: has to be called right before the tick runs
+void replay_record_tick(ReplayRecorder& recorder, const State& state);
+bool replay_record_end(
+  ReplayRecorder& recorder,
+  State& state,
+  const std::filesystem::path& filepath
+);
+
+bool replay_load(Replay& replay, const std::filesystem::path& filepath);
+// NOTE: loads the save the replay starts from
+void replay_begin(Replay& replay, State& state);
+// NOTE: puts the input of the next tick into the state, returns false once every tick was played
+bool replay_next_tick(Replay& replay, State& state);
+// NOTE: compares the state against the one the recording ended in, and prints the result
+bool replay_verify(const Replay& replay, State& state);
@@ -3,6 +3,9 @@
 #include <fstream>
 
 #include "json.hpp"
+
+#include "profiler.h"
+
 using json = nlohmann::json;
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(vec2, x, y);
@@ -24,7 +27,26 @@ void from_json(const json& j, ItemType& t) {
 }
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ItemSlot, flags, type, count, damage);
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(EntityId, idx, gen);
+void to_json(json& j, const EntityId& id) {
+  j = json{
+    {"idx", u32(id.idx)},
+    {"gen", u32(id.gen)},
+  };
+}
+
+// NOTE: older saves have 16 bit generations, one that doesnt fit anymore loads as a null id,
+// masking it could make a stale reference point at whatever lives in the slot now
+void from_json(const json& j, EntityId& id) {
+  auto idx = j.at("idx").get<u32>();
+  auto gen = j.at("gen").get<u32>();
+  ASSERT(idx <= ENTITY_ID_IDX_MAX, "entity index doesnt fit into an EntityId");
+  if (gen > ENTITY_ID_GEN_MAX) {
+    id = NULL_ENTITY;
+    return;
+  }
+  id.idx = idx;
+  id.gen = gen;
+}
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ConveyorItem, slot, t);
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Cogwheel, pos, radius, color);
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(LubricationPoint, dims, pos, color, progress);
@@ -248,15 +270,52 @@ void from_json(const json& j, EntityData& d) {
   }
 }
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(Entity, id, pos, world, data);
+NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(EntityPrototype, id, pos, world, data);
+
+// NOTE: entities are saved in idx order (free slots included as null entities),
+// so the save format doesnt depend on how the store lays them out in memory
 // TODO: could probably only serialize the entities vector
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(EntityStore, free_slots, next_entity_idx, entities);
+void to_json(json& j, const EntityStore& s) {
+  std::vector<EntityPrototype> entities(s.locations.size());
+  for (u32 i = 0; i < s.locations.size(); ++i) {
+    auto& location = s.locations[i];
+    if (location.id) {
+      entities[i] = entity_prototype(s.pools.entities[location.type][location.idx]);
+    }
+  }
+  j = json{
+    {"free_slots", s.free_slots},
+    {"next_entity_idx", s.next_entity_idx},
+    {"entities", entities},
+  };
+}
+
+// NOTE: free slots and entities with a generation that doesnt fit load with null ids (see above),
+// those slots are retired and the entities get new ids
+void from_json(const json& j, EntityStore& s) {
+  j.at("free_slots").get_to(s.free_slots);
+  std::erase(s.free_slots, NULL_ENTITY);
+  j.at("next_entity_idx").get_to(s.next_entity_idx);
+  auto& saved_entities = j.at("entities");
+  auto entities        = saved_entities.get<std::vector<EntityPrototype>>();
+  for (u32 i = 0; i < entities.size(); ++i) {
+    auto& entity = entities[i];
+    if (entity.id) {
+      add_entity_with_id(s, std::move(entity));
+    } else if (saved_entities[i].at("id").at("idx").get<u32>() != 0) {
+      add_entity(s, entity);
+    }
+  }
+  flush(s);
+}
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(ResourceMessageQueue, msgs);
 
 void to_json(json& j, const State& s) {
   j = json{
     {"version", s.SERIALIZATION_VERSION},
     {"minutes", s.minutes},
+    {"ticks", s.ticks},
+    {"random_seed", s.random_seed},
     {"resource_message_queue", s.resource_message_queue},
     {"player_id", s.player_id},
     {"resource_message_receiver_id", s.resource_message_receiver_id},
@@ -267,22 +326,65 @@ void to_json(json& j, const State& s) {
 void from_json(const json& j, State& s) {
   ASSERT(j.at("version") == s.SERIALIZATION_VERSION, "invalid serialization version");
   j.at("minutes").get_to(s.minutes);
+  // NOTE: older saves dont have these, they just start over with a new seed
+  s.ticks       = j.value("ticks", u64{});
+  s.random_seed = j.contains("random_seed") ? j.at("random_seed").get<u64>() : random_new_seed();
   j.at("resource_message_queue").get_to(s.resource_message_queue);
   j.at("player_id").get_to(s.player_id);
   j.at("resource_message_receiver_id").get_to(s.resource_message_receiver_id);
   j.at("store").get_to(s.store);
 }
 
-void save_state_to_file(const State& state, const std::filesystem::path& filepath) {
+std::string save_state_to_string(State& state) {
+  PROFILE_SCOPE("save_state", PROFILER_ZONE_DETAIL);
+  // NOTE: the save format still stores the items per conveyor
+  materialize_transport_lines(state.store);
+  json j(state);
+  return j.dump();
+}
+
+void save_state_to_file(State& state, const std::filesystem::path& filepath) {
+  PROFILE_SCOPE("save_state", PROFILER_ZONE_DETAIL);
+  // NOTE: the save format still stores the items per conveyor
+  materialize_transport_lines(state.store);
   json j(state);
   std::ofstream file{filepath};
   file << std::setw(4) << j << '\n';
 }
 
-void load_state_from_file(State& state, const std::filesystem::path& filepath) {
-  std::ifstream file{filepath};
-  json j         = json::parse(file);
-  auto new_state = j.get<State>();
+// NOTE: roughly, the map nodes hold 4 pointers next to the key and the value
+// and short strings are stored inside of the string itself
+static u64 json_dom_bytes(const json& j) {
+  u64 bytes = sizeof(json);
+  switch (j.type()) {
+    case json::value_t::object: {
+      auto& object = j.get_ref<const json::object_t&>();
+      bytes += sizeof(json::object_t);
+      for (auto& [key, value] : object) {
+        bytes += (4 * sizeof(void*)) + sizeof(key) + (key.capacity() > 15 ? key.capacity() : 0);
+        bytes += json_dom_bytes(value);
+      }
+    } break;
+    case json::value_t::array: {
+      auto& array = j.get_ref<const json::array_t&>();
+      bytes += sizeof(json::array_t) + ((array.capacity() - array.size()) * sizeof(json));
+      for (auto& value : array) {
+        bytes += json_dom_bytes(value);
+      }
+    } break;
+    case json::value_t::string: {
+      auto& string = j.get_ref<const json::string_t&>();
+      bytes += sizeof(json::string_t) + (string.capacity() > 15 ? string.capacity() : 0);
+    } break;
+    default:
+      break;
+  }
+  return bytes;
+}
+
+static void load_state(State& state, const json& j) {
+  auto new_state       = j.get<State>();
+  state.json_dom_bytes = json_dom_bytes(j);
 
   // TODO: pull this state assigning out to a separate function?
   // state.frame                  = {};
@@ -294,8 +396,31 @@ void load_state_from_file(State& state, const std::filesystem::path& filepath) {
   state.debug                  = {};
 
   state.minutes                      = new_state.minutes;
+  state.ticks                        = new_state.ticks;
+  state.random_seed                  = new_state.random_seed;
   state.resource_message_queue       = new_state.resource_message_queue;
   state.player_id                    = new_state.player_id;
   state.resource_message_receiver_id = new_state.resource_message_receiver_id;
-  state.store                        = new_state.store;
+  state.store                        = std::move(new_state.store);
+}
+
+void load_state_from_file(State& state, const std::filesystem::path& filepath) {
+  PROFILE_SCOPE("load_state", PROFILER_ZONE_DETAIL);
+  std::ifstream file{filepath};
+  load_state(state, json::parse(file));
+}
+
+void load_state_from_string(State& state, std::string_view str) {
+  PROFILE_SCOPE("load_state", PROFILER_ZONE_DETAIL);
+  load_state(state, json::parse(str));
+}
+
+u64 state_checksum(State& state) {
+  // NOTE: fnv-1a of the save, slow, but it covers everything a save does
+  u64 hash = 0xcbf29ce484222325;
+  for (char c : save_state_to_string(state)) {
+    hash ^= u8(c);
+    hash *= 0x100000001b3;
+  }
+  return hash;
 }
@@ -1,8 +1,14 @@
 #pragma once
 
 #include <filesystem>
+#include <string>
+#include <string_view>
 
 #include "game.h"
 
-void save_state_to_file(const State& state, const std::filesystem::path& filepath);
+void save_state_to_file(State& state, const std::filesystem::path& filepath);
 void load_state_from_file(State& state, const std::filesystem::path& filepath);
+std::string save_state_to_string(State& state);
+void load_state_from_string(State& state, std::string_view str);
+// NOTE: a hash of everything that gets saved, to check that two runs ended up in the same state
+u64 state_checksum(State& state);
@@ -0,0 +1,307 @@
+#include "simulation.h"
+
+#include "core.h"
+#include "input.h"
+#include "entity.h"
+#include "systems.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "memory.h"
+
+// NOTE: worlds only ever interact through world tunnels and the player,
+// both of which are handled by later systems, so every world is its own job
+static void simulate_worlds(State& state, f32 dt) {
+  validate_neighbours(state.store);
+  {
+    PROFILE_SCOPE("update_conveyor_graph", PROFILER_ZONE_DETAIL);
+    update_conveyor_graph(state.store);
+  }
+
+  // NOTE: the zones add up over the worlds, which run at the same time
+  JobCounter counter{};
+  for (u32 world = 0; world < WORLD_COUNT; ++world) {
+    job_push(counter, [&state, dt, world] {
+      {
+        PROFILE_SCOPE("output_items", PROFILER_ZONE_DETAIL);
+        system_output_items(state.store, World(world), dt);
+      }
+      {
+        PROFILE_SCOPE("move_items", PROFILER_ZONE_DETAIL);
+        system_move_items(state.store, World(world), dt);
+      }
+      {
+        PROFILE_SCOPE("progress_recipes", PROFILER_ZONE_DETAIL);
+        system_progress_recipes(state.store, World(world), dt);
+      }
+    });
+  }
+  job_wait(counter);
+}
+
+// NOTE: in the order they would run in serially, which decides the order of conflicting systems
+static void build_tick_schedule(State& state) {
+  auto& schedule = state.tick_schedule;
+
+  ResourceMask all_entities{};
+  ResourceMask inventories{};
+  ResourceMask maintenance{};
+  for_each_entity_type([&]<typename T>() {
+    all_entities |= entity_resources<T>();
+    if constexpr (HasInventory<T>) {
+      inventories |= entity_resources<T>();
+    }
+    if constexpr (HasMaintenance<T>) {
+      maintenance |= entity_resources<T>();
+    }
+  });
+
+  schedule_add(
+    schedule,
+    {
+      .name   = "apply_gui_actions",
+      .reads  = resources(RESOURCE_TIME),
+      .writes = maintenance | entity_resources<Player, Assembler, ResourceMessageSender>() |
+                resources(RESOURCE_MESSAGES, RESOURCE_ACTIVITY),
+      .run =
+        [&state](f32) {
+          system_apply_gui_actions(
+            state.store,
+            state.player_id,
+            state.gui_actions,
+            state.resource_message_queue,
+            state.minutes,
+            state.random_seed,
+            state.ticks
+          );
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "update_time",
+      .writes = resources(RESOURCE_TIME),
+      .run =
+        [&state](f32 dt) {
+          system_update_time(state.minutes, state.minutes_accumulator, dt);
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "move_player",
+      .writes = entity_resources<Player>() | resources(RESOURCE_SPATIAL, RESOURCE_EVENTS),
+      .run =
+        [&state](f32 dt) {
+          system_move_player(state.store, state.player_id, state.tick_input, dt);
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "open_gui",
+      .reads  = resources(RESOURCE_SPATIAL),
+      .writes = entity_resources<Player>() | resources(RESOURCE_ACTIVITY),
+      .run =
+        [&state](f32) {
+          system_open_gui(
+            state.store,
+            state.player_id,
+            state.tick_input,
+            state.frame.mouse_world_pos
+          );
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "close_gui",
+      .reads  = resources(RESOURCE_SPATIAL),
+      .writes = entity_resources<Player>(),
+      .run    = [&state](f32) { system_close_gui(state.store, state.player_id, state.tick_input); },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "hand_slot_interactions",
+      .writes = all_entities,
+      .run =
+        [&state](f32) {
+          system_hand_slot_interactions(
+            state.store,
+            state.player_id,
+            state.frame.hovered_slot,
+            state.tick_input
+          );
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "drop_items",
+      .reads  = resources(RESOURCE_SPATIAL),
+      .writes = entity_resources<Player>() | resources(RESOURCE_COMMANDS),
+      .run =
+        [&state](f32) {
+          system_drop_items(
+            state.store,
+            state.player_id,
+            state.tick_input,
+            state.frame.mouse_world_pos
+          );
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "place_entity",
+      .reads  = entity_resources<Conveyor>() | resources(RESOURCE_SPATIAL),
+      .writes = entity_resources<Player>() | resources(RESOURCE_COMMANDS),
+      .run =
+        [&state](f32) {
+          system_place_entity(
+            state.store,
+            state.player_id,
+            state.tick_input,
+            state.frame.mouse_world_pos,
+            state.current_place_rotation
+          );
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "remove_entity",
+      .reads  = all_entities | resources(RESOURCE_SPATIAL),
+      .writes = entity_resources<Conveyor>() |
+                resources(RESOURCE_ACTIVITY, RESOURCE_CONVEYOR_GRAPH, RESOURCE_COMMANDS),
+      .run =
+        [&state](f32) {
+          system_remove_entity(
+            state.store,
+            state.player_id,
+            state.tick_input,
+            state.frame.mouse_world_pos
+          );
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "pickup_item",
+      .reads  = resources(RESOURCE_EVENTS),
+      .writes = entity_resources<Player, Item>() | resources(RESOURCE_COMMANDS),
+      .run    = [&state](f32) { system_pickup_item(state.store, state.player_id); },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "simulate_worlds",
+      .reads  = all_entities | resources(RESOURCE_SPATIAL),
+      .writes = inventories | entity_resources<Conveyor, Assembler>() |
+                resources(RESOURCE_ACTIVITY, RESOURCE_CONVEYOR_GRAPH),
+      .run    = [&state](f32 dt) { simulate_worlds(state, dt); },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "tunnel_through_worlds",
+      .reads  = resources(RESOURCE_EVENTS),
+      .writes = entity_resources<Player, WorldTunnel>() |
+                resources(RESOURCE_SPATIAL, RESOURCE_ACTIVITY),
+      .run    = [&state](f32) { system_tunnel_through_worlds(state.store, state.player_id); },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "transfer_resource_messages",
+      .reads  = resources(RESOURCE_TIME),
+      .writes = entity_resources<ResourceMessageReceiver>() |
+                resources(RESOURCE_MESSAGES, RESOURCE_ACTIVITY),
+      .run =
+        [&state](f32) {
+          system_transfer_resource_messages(
+            state.store,
+            state.resource_message_receiver_id,
+            state.resource_message_queue,
+            state.minutes
+          );
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "apply_maintenance",
+      .writes = maintenance,
+      .run =
+        [&state](f32) {
+          system_apply_maintenance(state.store, state.random_seed, state.ticks);
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "update_maintenance_minigames",
+      .writes = maintenance | resources(RESOURCE_ACTIVITY),
+      .run =
+        [&state](f32 dt) {
+          system_update_maintenance_minigames(state.store, state.tick_input, dt);
+        },
+    }
+  );
+  schedule_add(
+    schedule,
+    {
+      .name   = "update_camera",
+      .reads  = entity_resources<Player>() | resources(RESOURCE_SPATIAL),
+      .writes = resources(RESOURCE_CAMERA),
+      .run =
+        [&state](f32) {
+          system_update_camera(
+            state.camera,
+            state.tick_input,
+            state.store,
+            state.player_id,
+            state.frame.window_dims
+          );
+        },
+    }
+  );
+  schedule_build(schedule);
+}
+
+void simulation_tick(State& state, f32 dt) {
+  PROFILE_SCOPE("simulation_tick", PROFILER_ZONE_DETAIL);
+  auto allocations_before = allocation_stats();
+
+  // TODO: i dont think this belongs in a system, but maybe?
+  if (action_state(state.tick_input, ACTION_ROTATE).pressed()) {
+    state.current_place_rotation = next_direction(state.current_place_rotation);
+  }
+
+  if (state.tick_schedule.systems.empty()) {
+    build_tick_schedule(state);
+  }
+  schedule_run(state.tick_schedule, dt);
+
+  PROFILE_SCOPE("flush_and_clear_events", PROFILER_ZONE_SYSTEM);
+  flush(state.store);
+  clear_event_bus(state.store);
+  state.gui_actions.clear();
+  ++state.ticks;
+
+  state.tick_allocations = allocation_stats_since(allocations_before);
+}
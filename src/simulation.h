@@ -0,0 +1,8 @@
+#pragma once
+
+#include "core.h"
+#include "game.h"
+
+// NOTE: one tick of MODE_GAME, commands flushed and events cleared at the end
+// it doesnt need a window, so game_headless runs it directly instead of update_tick()
+void simulation_tick(State& state, f32 dt);
@@ -8,6 +8,7 @@
 #include "entity.h"
 #include "input.h"
 #include "items.h"
+#include "jobs.h"
 
 static bool pos_in_radius(const vec2& pos, const vec2& start_pos, f32 radius) {
   auto diff2 = length2(pos - start_pos);
@@ -52,10 +53,7 @@ void system_move_player(EntityStore& store, EntityId player_id, const Input& inp
     );
 
     for (auto& collision : collided) {
-      movement->collision_events.push_back({
-        .type   = EVENT_PLAYER_COLLIDED,
-        .entity = collision->id,
-      });
+      movement->collision_events.push_back({.entity = collision->id});
       if (solid(*collision)) {
         can_move = false;
       }
@@ -75,7 +73,12 @@ void system_move_player(EntityStore& store, EntityId player_id, const Input& inp
   if (curr_move) {
     curr_move->t += dt;
     if (curr_move->t >= PLAYER_MOVE_ACTION_DURATION) {
-      player_entity->pos += direction_to_vec2(curr_move->direction);
+      set_entity_pos(
+        store,
+        *player_entity,
+        player_entity->pos + direction_to_vec2(curr_move->direction),
+        player_entity->world
+      );
       for (auto& event : curr_move->collision_events) {
         emit(store, event);
       }
@@ -103,6 +106,12 @@ void system_open_gui(
       player->open_gui = hovered->id;
     }
   }
+
+  // NOTE: the gui can change pretty much anything about the entity (recipe, maintenance, inventory)
+  // so it just never sleeps while its open
+  if (player->open_gui) {
+    wake(store, player->open_gui);
+  }
 }
 
 void system_close_gui(EntityStore& store, EntityId player_id, const Input& input) {
@@ -122,6 +131,124 @@ void system_close_gui(EntityStore& store, EntityId player_id, const Input& input
   }
 }
 
+// NOTE: what the FIX button does, using up (or damaging) the fix item in the hand,
+// returns whether the maintenance is done, the ones with a minigame only get it opened
+static bool fix_maintenance(Player& player, Maintenance& maintenance, Random& random) {
+  auto fix_item = maintenance_fix_item(maintenance);
+  if (player.hand.type != fix_item || player.hand.count < MAINTENANCE_FIX_ITEM_COUNT) {
+    // TODO: notify the user they dont have the item
+    return false;
+  }
+  auto hand_item_info = item_info(player.hand.type);
+  if (hand_item_info.has_durability) {
+    if (hand_item_info.max_damage - player.hand.damage < MAINTENANCE_FIX_ITEM_DAMAGE) {
+      return false;
+    }
+    player.hand.damage += MAINTENANCE_FIX_ITEM_DAMAGE;
+  } else {
+    player.hand.count -= MAINTENANCE_FIX_ITEM_COUNT;
+  }
+
+  auto* minigame_open = maintenance_is_minigame_open(maintenance);
+  if (minigame_open) {
+    *minigame_open = true;
+    // TODO: maybe check if inited in update and init there?
+    maintenance_init_minigame(maintenance, random);
+    return false;
+  }
+  maintenance = std::monostate{};
+  return true;
+}
+
+void system_apply_gui_actions(
+  EntityStore& store,
+  EntityId player_id,
+  std::span<const GuiAction> actions,
+  ResourceMessageQueue& msg_queue,
+  u64 game_time,
+  u64 random_seed,
+  u64 tick
+) {
+  auto* player = get_data<Player>(store, player_id);
+  ASSERT_NO_MSG(player);
+  auto random = random_stream(random_seed, RANDOM_STREAM_MINIGAMES, tick);
+
+  for (auto& action : actions) {
+    auto* entity = get_entity(store, action.entity);
+    // NOTE: the gui could have been closed since the click, or the entity removed
+    if (!entity || action.entity != player->open_gui) {
+      continue;
+    }
+
+    if (action.type == GUI_ACTION_FIX_MAINTENANCE) {
+      visit(*entity, [&]<typename T>(T& data) {
+        if constexpr (HasMaintenance<T>) {
+          auto* minigame_open = maintenance_is_minigame_open(data.maintenance);
+          if (
+            data.maintenance.index() != 0 && !(minigame_open && *minigame_open) &&
+            fix_maintenance(*player, data.maintenance, random)
+          ) {
+            wake(store, entity->id);
+          }
+        }
+      });
+      continue;
+    }
+
+    if (auto* assembler = get_data<Assembler>(*entity)) {
+      if (
+        action.type == GUI_ACTION_SELECT_RECIPE && assembler->maintenance.index() == 0 &&
+        action.idx < Assembler::RECIPES.size() && action.idx != assembler->selected_recipe_idx
+      ) {
+        assembler->selected_recipe_idx = action.idx;
+        // TODO: pull out to a clear or something function
+        assembler->t = 0;
+        wake(store, entity->id);
+      }
+      continue;
+    }
+
+    auto* msg_sender = get_data<ResourceMessageSender>(*entity);
+    if (!msg_sender || msg_sender->maintenance.index() != 0) {
+      continue;
+    }
+    auto& msg = msg_sender->msg_in_create;
+    switch (action.type) {
+      case GUI_ACTION_SWITCH_SENDER_PAGE: {
+        if (action.idx <= SENDER_PAGE_CREATE) {
+          msg_sender->page = ResourceMessageSenderPage(action.idx);
+        }
+      } break;
+      case GUI_ACTION_ADD_REQUESTED_ITEM: {
+        if (
+          action.idx < msg.requested_items.size() &&
+          msg.requested_items[action.idx] < item_info(REQUESTABLE_ITEMS[action.idx]).max_count
+        ) {
+          msg.requested_items[action.idx] += REQUESTED_ITEMS_MULTIPLE;
+        }
+      } break;
+      case GUI_ACTION_REMOVE_REQUESTED_ITEM: {
+        if (action.idx < msg.requested_items.size() && msg.requested_items[action.idx] > 0) {
+          msg.requested_items[action.idx] -= REQUESTED_ITEMS_MULTIPLE;
+        }
+      } break;
+      case GUI_ACTION_CREATE_MESSAGE: {
+        if (std::ranges::any_of(msg.requested_items, [](u32 count) { return count > 0; })) {
+          add_resource_message(msg_queue, msg, game_time);
+          msg = {};
+        }
+      } break;
+      case GUI_ACTION_CANCEL_MESSAGE: {
+        if (action.idx < msg_queue.msgs.size()) {
+          remove_resource_message(msg_queue, action.idx);
+        }
+      } break;
+      default:
+        break;
+    }
+  }
+}
+
 void system_hand_slot_interactions(
   EntityStore& store,
   EntityId player_id,
@@ -132,9 +259,9 @@ void system_hand_slot_interactions(
   ASSERT_NO_MSG(player_entity && player);
 
   if (hovered_slot && input.lmb.pressed()) {
-    auto* hovered_inv = get_inventory(store, hovered_slot.entity);
-    if (hovered_inv) {
-      auto& slot = (*hovered_inv)[hovered_slot.slot_idx];
+    auto hovered_inv = get_inventory(store, hovered_slot.entity);
+    if (!hovered_inv.empty()) {
+      auto& slot = hovered_inv[hovered_slot.slot_idx];
       auto& hand = player->hand;
       ASSERT(hand.flags == ITEM_SLOT_FLAGS_ALL, "player hand has to be input and output");
 
@@ -177,7 +304,7 @@ void system_drop_items(
   ) {
     auto hovered = get_entity_at_pos(store, mouse_grid_pos, player_entity->world, CURSOR_DIMS);
     if (!hovered || is<Item>(*hovered)) {
-      Entity entity = {
+      EntityPrototype entity = {
         .pos   = mouse_grid_pos,
         .world = player_entity->world,
         .data  = Item{.slot = player->hand},
@@ -188,16 +315,7 @@ void system_drop_items(
   }
 }
 
-enum ItemTransferMode {
-  ITEM_TRANSFER_HAND,
-  ITEM_TRANSFER_MACHINE,
-};
-
-// NOTE: returns whether it succeeded in transfering all items from the slot into the inventory
-// also modified the slot to contain the left amount of items after the transfer
-// so if it succeeded slot.count == 0
-static bool
-transfer_items(std::vector<ItemSlot>& inventory, ItemSlot& slot, ItemTransferMode mode) {
+bool transfer_items(std::span<ItemSlot> inventory, ItemSlot& slot, ItemTransferMode mode) {
   ItemSlotFlag input_flag;
   ItemSlotFlag output_flag;
   switch (mode) {
@@ -242,7 +360,7 @@ transfer_items(std::vector<ItemSlot>& inventory, ItemSlot& slot, ItemTransferMod
 }
 
 static bool
-transfer_items(std::vector<ItemSlot>& to, std::span<ItemSlot> from, ItemTransferMode mode) {
+transfer_items(std::span<ItemSlot> to, std::span<ItemSlot> from, ItemTransferMode mode) {
   for (auto& slot : from) {
     if (!transfer_items(to, slot, mode)) {
       return false;
@@ -279,6 +397,7 @@ void system_transfer_resource_messages(
       swap_slot_flags(msg_receiver->inventory);
       transfer_items(msg_receiver->inventory, msg_items, ITEM_TRANSFER_MACHINE);
       swap_slot_flags(msg_receiver->inventory);
+      wake(store, message_receiver_id);
       remove_resource_message(msg_queue, i);
     } else {
       ++i;
@@ -286,18 +405,15 @@ void system_transfer_resource_messages(
   }
 }
 
-void system_progress_recipes(EntityStore& store, f32 dt) {
-  for (auto& entity : store) {
-    auto* assembler = get_data<Assembler>(entity);
-    if (!assembler) {
-      continue;
-    }
-
-    if (assembler->maintenance.index() != 0) {
-      continue;
+// NOTE: assemblers that cant make progress go to sleep,
+// until their inventory changes or the maintenance gets fixed
+void system_progress_recipes(EntityStore& store, World world, f32 dt) {
+  auto progress = [&](Entity& entity, Assembler& assembler) {
+    if (assembler.maintenance.index() != 0) {
+      return false;
     }
 
-    auto& selected_recipe = Assembler::RECIPES[assembler->selected_recipe_idx];
+    auto& selected_recipe = Assembler::RECIPES[assembler.selected_recipe_idx];
     bool inputs_ok        = true;
     // TODO: this shouldnt really care about the ordering of the items
     // or maybe it should, but i could add a way to lock item slots to only a specific kind
@@ -306,7 +422,7 @@ void system_progress_recipes(EntityStore& store, f32 dt) {
       if (!recipe_input) {
         continue;
       }
-      auto& assembler_input = assembler_input_slot(*assembler, i);
+      auto& assembler_input = assembler_input_slot(assembler, i);
       if (assembler_input.type != recipe_input.type || assembler_input.count < recipe_input.count) {
         inputs_ok = false;
         break;
@@ -319,7 +435,7 @@ void system_progress_recipes(EntityStore& store, f32 dt) {
       if (!recipe_output) {
         continue;
       }
-      auto& assembler_output = assembler_output_slot(*assembler, i);
+      auto& assembler_output = assembler_output_slot(assembler, i);
       if (assembler_output && assembler_output.type != recipe_output.type) {
         output_ok = false;
         break;
@@ -332,19 +448,22 @@ void system_progress_recipes(EntityStore& store, f32 dt) {
 
     if (inputs_ok) {
       if (output_ok) {
-        assembler->t += dt;
+        assembler.t += dt;
       }
     } else {
-      assembler->t = 0;
+      assembler.t = 0;
+    }
+    if (!inputs_ok || !output_ok) {
+      return false;
     }
 
-    if (assembler->t >= selected_recipe.recipe_time) {
+    if (assembler.t >= selected_recipe.recipe_time) {
       for (u32 i = 0; i < Recipe::MAX_INPUT_SLOTS; ++i) {
         auto& recipe_input = selected_recipe.input_slots[i];
         if (!recipe_input) {
           continue;
         }
-        auto& assembler_input = assembler_input_slot(*assembler, i);
+        auto& assembler_input = assembler_input_slot(assembler, i);
         assembler_input.count -= recipe_input.count;
       }
       for (u32 i = 0; i < Recipe::MAX_OUTPUT_SLOTS; ++i) {
@@ -352,13 +471,17 @@ void system_progress_recipes(EntityStore& store, f32 dt) {
         if (!recipe_output) {
           continue;
         }
-        auto& assembler_output = assembler_output_slot(*assembler, i);
+        auto& assembler_output = assembler_output_slot(assembler, i);
         assembler_output.type  = recipe_output.type;
         assembler_output.count += recipe_output.count;
       }
-      assembler->t -= selected_recipe.recipe_time;
+      assembler.t -= selected_recipe.recipe_time;
+      // NOTE: there is something to output now, and room for more inputs
+      wake(store, entity.id);
     }
-  }
+    return true;
+  };
+  for_each_active<Assembler>(store, world, ACTIVITY_RECIPES, progress);
 }
 
 void system_place_entity(
@@ -423,15 +546,19 @@ void system_remove_entity(
       auto item_type = entity_to_item(*hovered);
       ASSERT(item_type, "broken breakable item doesnt have an item_type");
 
-      Entity entity = {
+      EntityPrototype entity = {
         .pos   = hovered->pos,
         .world = player_entity->world,
         .data  = Item{.slot = {.type = *item_type, .count = 1}},
       };
       add_entity(store, entity);
 
+      // NOTE: the items on a conveyor are only up to date once its transport line got written back
+      if (is<Conveyor>(*hovered)) {
+        detach_transport_line(store, hovered->id);
+      }
       for_each_active_slot(*hovered, [&](const ItemSlot& slot) {
-        Entity item_entity = {
+        EntityPrototype item_entity = {
           .pos   = hovered->pos,
           .world = player_entity->world,
           .data  = Item{.slot = slot},
@@ -448,7 +575,7 @@ void system_pickup_item(EntityStore& store, EntityId player_id) {
   auto* player = get_data<Player>(store, player_id);
   ASSERT_NO_MSG(player);
 
-  for (auto& event : listen(store, EVENT_PLAYER_COLLIDED)) {
+  for (auto& event : listen<PlayerCollidedEvent>(store)) {
     auto* item = get_data<Item>(store, event.entity);
     if (item) {
       if (transfer_items(player->inventory, item->slot, ITEM_TRANSFER_HAND)) {
@@ -458,7 +585,7 @@ void system_pickup_item(EntityStore& store, EntityId player_id) {
   }
 }
 
-static ItemSlot* find_first_extractable_slot(std::vector<ItemSlot>& inventory) {
+static ItemSlot* find_first_extractable_slot(std::span<ItemSlot> inventory) {
   for (u32 i = 0; i < inventory.size(); ++i) {
     if (inventory[i] && (inventory[i].flags & ITEM_SLOT_MACHINE_OUTPUT)) {
       return &inventory[i];
@@ -467,174 +594,138 @@ static ItemSlot* find_first_extractable_slot(std::vector<ItemSlot>& inventory) {
   return nullptr;
 }
 
-void system_output_items(EntityStore& store, f32 dt) {
-  static constexpr std::array<std::pair<Direction, vec2>, 4> SIDES = {{
-    {DIR_RIGHT, {1, 0}},
-    {DIR_DOWN, {0, 1}},
-    {DIR_LEFT, {-1, 0}},
-    {DIR_UP, {0, -1}},
-  }};
-
-  // TODO: only do anything if a conveyor is attached?
-  for (auto& entity : store) {
-    auto output_properties = get_outputs_items_properties(entity);
-    if (!output_properties.item_output_accumulator) {
-      continue;
-    }
-
-    *output_properties.item_output_accumulator += dt;
+void system_output_items(EntityStore& store, World world, f32 dt) {
+  for_each_entity_type([&]<typename T>() {
+    if constexpr (OutputsItems<T>) {
+      // NOTE: sleeps while there is nothing attached or nothing to output
+      for_each_active<T>(store, world, ACTIVITY_OUTPUT, [&](Entity& entity, T& data) {
+        if (!data.output_neighbours[0] || !find_first_extractable_slot(data.inventory)) {
+          return false;
+        }
 
-    if (*output_properties.item_output_accumulator >= (1.0f / output_properties.output_rate)) {
-      auto* from_inv = get_inventory(entity);
-      ASSERT(from_inv, "entities with OutputsItems must satisfy HasInventory");
-      auto dims = get_dims(entity);
+        data.item_output_accumulator += dt;
+        if (data.item_output_accumulator < (1.0f / T::OUTPUT_RATE)) {
+          return true;
+        }
 
-      for (u32 y = 0; y < u32(dims.y); ++y) {
-        for (u32 x = 0; x < u32(dims.x); ++x) {
-          auto pos = entity.pos + vec2{f32(x), f32(y)};
-          for (auto [side, side_vector] : SIDES) {
-            if (!(output_properties.output_sides[(dims.x * y) + x] & side)) {
-              continue;
-            }
-            auto output_pos = pos + side_vector;
-            auto* output_entity =
-              get_entity_at_pos(store, output_pos, entity.world, Conveyor::DIMS);
-            if (!output_entity) {
-              continue;
-            }
-            auto* conveyor = get_data<Conveyor>(*output_entity);
-            if (!conveyor) {
-              continue;
-            }
-            if (!conveyor_points_from(*output_entity, pos)) {
-              continue;
+        for (auto output_id : data.output_neighbours) {
+          if (!output_id) {
+            break;
+          }
+          auto* output_entity = get_entity(store, output_id);
+          ASSERT(output_entity, "stale output neighbour");
+
+          auto* first_extractable = find_first_extractable_slot(data.inventory);
+          if (first_extractable) {
+            // TODO: do i extract this into some function?
+            // like somehow use transfer_items() here?
+            ItemSlot slot       = {.type = first_extractable->type, .count = 1};
+            bool has_durability = item_info(first_extractable->type).has_durability;
+            if (has_durability) {
+              slot.damage = first_extractable->damage;
             }
-
-            for (u32 i = 0; i < CONVEYOR_THROUGHPUT; ++i) {
-              auto& item    = conveyor->items[i];
-              bool can_pull = !item.slot;
-              if (can_pull) {
-                auto* first_extractable = find_first_extractable_slot(*from_inv);
-                if (first_extractable) {
-                  // TODO: do i extract this into some function?
-                  // like somehow use transfer_items() here?
-                  item.slot.type  = first_extractable->type;
-                  item.slot.count = 1;
-                  if (item_info(first_extractable->type).has_durability) {
-                    item.slot.damage          = first_extractable->damage;
-                    first_extractable->damage = 0;
-                  }
-                  --first_extractable->count;
-                }
-                break;
+            if (transport_line_push(store, *output_entity, slot)) {
+              if (has_durability) {
+                first_extractable->damage = 0;
               }
+              --first_extractable->count;
+              // NOTE: an output slot got emptied
+              wake(store, entity.id);
             }
           }
         }
-      }
 
-      *output_properties.item_output_accumulator = 0;
+        data.item_output_accumulator = 0;
+        return true;
+      });
     }
-  }
+  });
 }
 
-void system_move_items(EntityStore& store, f32 dt) {
-  static constexpr f32 ITEM_GAP = 1.0f / CONVEYOR_THROUGHPUT;
-  std::vector<std::pair<Entity, Entity&>> buffer{};
-  for (auto& entity : store) {
-    if (is<Conveyor>(entity)) {
-      buffer.push_back({entity, entity});
-    }
-  }
-
-  for (auto& [entity, old_entity] : buffer) {
-    const auto* old_conveyor = get_data<Conveyor>(old_entity);
-    auto* conveyor           = get_data<Conveyor>(entity);
-    ASSERT_NO_MSG(old_conveyor && conveyor);
-
-    // NOTE: move items that are already on the conveyor
-    for (u32 i = 0; i < CONVEYOR_THROUGHPUT; ++i) {
-      auto& item = conveyor->items[i];
-      if (item.slot) {
-        if (item.t < 1 - (i * ITEM_GAP)) {
-          item.t += dt;
+// NOTE: lines go to sleep once nothing on them can move anymore,
+// until an item gets put on them or whatever they hand off into changes
+// hand offs into machines go first in line order, because lines can share a target,
+// after that every line only touches itself, so the lines get moved in parallel ranges
+void system_move_items(EntityStore& store, World world, f32 dt) {
+  auto conveyors     = view<Conveyor>(store);
+  auto& graph        = store.conveyor_graph;
+  auto& active_lines = graph.active_lines[world];
+  auto& keep_awake   = graph.keep_awake[world];
+  ASSERT(!graph.dirty, "the conveyor graph has to be up to date before moving items");
+
+  // NOTE: wake() can append lines while this runs, those get handled this tick as well
+  keep_awake.clear();
+  for (u32 i = 0; i < active_lines.size(); ++i) {
+    auto& line      = graph.lines[active_lines[i]];
+    auto items      = transport_line_items(line);
+    bool handed_off = false;
+    if (!line.looped && !items.empty() && items[0].gap <= 0.0f) {
+      auto& head      = items[0];
+      auto* to_entity = get_entity(store, conveyors.data[line.conveyors[0]].to_neighbour);
+      // NOTE: a conveyor that would accept the item is linked, so it would be part of this line
+      if (to_entity && !is<Conveyor>(*to_entity)) {
+        auto to_inv = get_inventory(*to_entity);
+        if (!to_inv.empty() && transfer_items(to_inv, head.slot, ITEM_TRANSFER_MACHINE)) {
+          transport_line_pop(line);
+          wake(store, to_entity->id);
+          handed_off = true;
         }
-      } else {
-        item.t = 0;
       }
     }
+    keep_awake.push_back(handed_off);
+  }
 
-    // NOTE: take items on
-    {
-      vec2 from_pos         = old_entity.pos + direction_to_vec2(old_conveyor->rotation);
-      auto* old_from_entity = get_entity_at_pos(store, from_pos, old_entity.world, {1, 1});
-      if (old_from_entity && is<Conveyor>(*old_from_entity)) {
-        const auto* old_from_conveyor = get_data<Conveyor>(*old_from_entity);
-        ASSERT_NO_MSG(old_from_conveyor);
-        const auto& old_from_item = old_from_conveyor->items[0];
-        if (conveyor_points_to(*old_from_entity, old_entity.pos) && old_from_item.t >= 1.0f) {
-          for (u32 i = 0; i < CONVEYOR_THROUGHPUT; ++i) {
-            const auto& old_item = old_conveyor->items[i];
-            auto& item           = conveyor->items[i];
-            if (!old_item.slot) {
-              assign_slot(item.slot, old_from_item.slot);
-              item.t = 0;
-              break;
-            }
-          }
+  auto move_lines = [&](u32 begin, u32 end) {
+    for (u32 i = begin; i < end; ++i) {
+      auto& line = graph.lines[active_lines[i]];
+      auto items = transport_line_items(line);
+      // NOTE: looped lines hand off into themselves
+      if (line.looped && !items.empty() && items[0].gap <= 0.0f) {
+        if (line.entry_gap >= CONVEYOR_ITEM_GAP) {
+          auto slot = items[0].slot;
+          transport_line_pop(line);
+          transport_line_push(line, slot);
+          keep_awake[i] = true;
         }
       }
-    }
-
-    // NOTE: push items off
-    {
-      auto& old_item = old_conveyor->items[0];
-      auto& item     = conveyor->items[0];
-
-      if (old_item.t >= 1.0f) {
-        vec2 to_pos         = old_entity.pos + direction_to_vec2(old_conveyor->to);
-        auto* old_to_entity = get_entity_at_pos(store, to_pos, old_entity.world, {1, 1});
-        if (old_to_entity && !is<Player>(*old_to_entity)) {
-          bool success = false;
-
-          if (const auto* old_to_conveyor = get_data<Conveyor>(*old_to_entity)) {
-            if (conveyor_points_from(*old_to_entity, old_entity.pos)) {
-              for (u32 i = 0; i < CONVEYOR_THROUGHPUT; ++i) {
-                const auto& old_to_item = old_to_conveyor->items[i];
-                if (!old_to_item.slot) {
-                  assign_slot(item.slot, old_to_item.slot);
-                  item.t  = 0;
-                  success = true;
-                  break;
-                }
-              }
-            }
-          } else if (auto* to_inv = get_inventory(*old_to_entity)) {
-            success = transfer_items(*to_inv, item.slot, ITEM_TRANSFER_MACHINE);
-          }
-
-          if (success) {
-            std::ranges::rotate(conveyor->items, conveyor->items.begin() + 1);
-          }
-        }
+      if (transport_line_move(line, dt)) {
+        keep_awake[i] = true;
       }
     }
+  };
+  u32 count        = active_lines.size();
+  u32 thread_count = job_thread_count();
+  u32 range_size   = (count + thread_count - 1) / thread_count;
+  range_size       = std::max(range_size, MOVE_ITEMS_MIN_LINES_PER_JOB);
+  if (count <= range_size) {
+    move_lines(0, count);
+  } else {
+    JobCounter counter{};
+    for (u32 begin = 0; begin < count; begin += range_size) {
+      u32 end = std::min(begin + range_size, count);
+      job_push(counter, [&move_lines, begin, end] { move_lines(begin, end); });
+    }
+    job_wait(counter);
   }
 
-  for (auto& [entity, old_entity] : buffer) {
-    old_entity = entity;
+  // NOTE: stable, so the hand off order of the lines doesnt depend on when others went to sleep
+  u32 kept = 0;
+  for (u32 i = 0; i < count; ++i) {
+    if (keep_awake[i]) {
+      active_lines[kept++] = active_lines[i];
+    } else {
+      graph.lines[active_lines[i]].active = false;
+    }
   }
+  active_lines.resize(kept);
 }
 
 Entity* find_corresponding_world_tunnel(EntityStore& store, Entity& tunnel_entity) {
   auto* tunnel = get_data<WorldTunnel>(tunnel_entity);
   ASSERT(tunnel, "cannot find corresponding world tunnel of none world tunnel entity");
-  for (auto& entity : store) {
-    if (entity.world == tunnel->to) {
-      auto* tunnel = get_data<WorldTunnel>(entity);
-      if (tunnel && tunnel->to == tunnel_entity.world) {
-        return &entity;
-      }
+  for (auto [entity, other_tunnel] : view<WorldTunnel>(store)) {
+    if (entity.world == tunnel->to && other_tunnel.to == tunnel_entity.world) {
+      return &entity;
     }
   }
   return nullptr;
@@ -646,72 +737,81 @@ void system_tunnel_through_worlds(EntityStore& store, EntityId player_id) {
   ASSERT_NO_MSG(player_entity);
 
   // NOTE: player
-  for (auto& event : listen(store, EVENT_PLAYER_COLLIDED)) {
+  for (auto& event : listen<PlayerCollidedEvent>(store)) {
     auto [tunnel_entity, tunnel] = get_entity_and_data<WorldTunnel>(store, event.entity);
     ASSERT_NO_MSG(tunnel_entity);
     if (tunnel) {
       auto* corresponding_tunnel_entity = find_corresponding_world_tunnel(store, *tunnel_entity);
       ASSERT(corresponding_tunnel_entity, "there should always be a corresponding tunnel");
-      player_entity->world = tunnel->to;
-      player_entity->pos   = corresponding_tunnel_entity->pos;
+      set_entity_pos(store, *player_entity, corresponding_tunnel_entity->pos, tunnel->to);
     }
   }
 
   // NOTE: items
-  for (auto& entity : store) {
-    if (auto* tunnel = get_data<WorldTunnel>(entity)) {
-      auto* corresponding_tunnel_entity = find_corresponding_world_tunnel(store, entity);
-      ASSERT(corresponding_tunnel_entity, "there should always be a corresponding tunnel");
-      auto* corresponding_tunnel = get_data<WorldTunnel>(*corresponding_tunnel_entity);
-      ASSERT_NO_MSG(corresponding_tunnel);
-
-      swap_slot_flags(corresponding_tunnel->inventory);
-      swap_slot_flags(tunnel->inventory);
-      transfer_items(corresponding_tunnel->inventory, tunnel->inventory, ITEM_TRANSFER_MACHINE);
-      swap_slot_flags(corresponding_tunnel->inventory);
-      swap_slot_flags(tunnel->inventory);
+  for (auto [entity, tunnel] : view<WorldTunnel>(store)) {
+    auto* corresponding_tunnel_entity = find_corresponding_world_tunnel(store, entity);
+    ASSERT(corresponding_tunnel_entity, "there should always be a corresponding tunnel");
+    auto* corresponding_tunnel = get_data<WorldTunnel>(*corresponding_tunnel_entity);
+    ASSERT_NO_MSG(corresponding_tunnel);
+
+    bool has_items = std::ranges::any_of(tunnel.inventory, [](const ItemSlot& slot) {
+      return bool(slot) && (slot.flags & ITEM_SLOT_MACHINE_INPUT);
+    });
+    swap_slot_flags(corresponding_tunnel->inventory);
+    swap_slot_flags(tunnel.inventory);
+    transfer_items(corresponding_tunnel->inventory, tunnel.inventory, ITEM_TRANSFER_MACHINE);
+    swap_slot_flags(corresponding_tunnel->inventory);
+    swap_slot_flags(tunnel.inventory);
+    if (has_items) {
+      wake(store, corresponding_tunnel_entity->id);
+      wake(store, entity.id);
     }
   }
 }
 
-void system_apply_maintenance(EntityStore& store) {
-  for (auto& entity : store) {
-    auto [maintenance, possible_maintenance] = get_maintenance(entity);
-    if (!maintenance || maintenance->index() != 0) {
-      continue;
-    }
+void system_apply_maintenance(EntityStore& store, u64 random_seed, u64 tick) {
+  for_each_entity_type([&]<typename T>() {
+    if constexpr (HasMaintenance<T>) {
+      for (auto [entity, data] : view<T>(store)) {
+        if (data.maintenance.index() != 0) {
+          continue;
+        }
 
-    // TODO: is this a good chance?
-    auto value = random_get<u32>(1, 10000);
-    if (value != 1) {
-      continue;
-    }
+        auto random =
+          random_stream(random_seed, RANDOM_STREAM_MAINTENANCE, tick, u64(entity.id.idx));
+        // TODO: is this a good chance?
+        auto value = random_get<u32>(random, 1, 10000);
+        if (value != 1) {
+          continue;
+        }
 
-    auto maintenance_idx = random_get<u32>(0, possible_maintenance.size() - 1);
-    *maintenance         = possible_maintenance[maintenance_idx];
-    std::println("Maintenance needs happened!");
-    std::println("Current maintenance: {}", maintenance_name(*maintenance));
-  }
+        auto maintenance_idx = random_get<u32>(random, 0, T::POSSIBLE_MAINTENANCE.size() - 1);
+        data.maintenance     = T::POSSIBLE_MAINTENANCE[maintenance_idx];
+        std::println("Maintenance needs happened!");
+        std::println("Current maintenance: {}", maintenance_name(data.maintenance));
+      }
+    }
+  });
 }
 
 void system_update_maintenance_minigames(EntityStore& store, const Input& input, f32 dt) {
-  for (auto& entity : store) {
-    auto [maintenance, _] = get_maintenance(entity);
-    if (!maintenance) {
-      continue;
-    }
-
-    auto* minigame_open = maintenance_is_minigame_open(*maintenance);
-    if (!minigame_open || !*minigame_open) {
-      continue;
-    }
+  for_each_entity_type([&]<typename T>() {
+    if constexpr (HasMaintenance<T>) {
+      for (auto [entity, data] : view<T>(store)) {
+        auto* minigame_open = maintenance_is_minigame_open(data.maintenance);
+        if (!minigame_open || !*minigame_open) {
+          continue;
+        }
 
-    // TODO: should only apply mouse inputs if the player hand is empty
-    bool done = maintenance_update_minigame(*maintenance, input, dt);
-    if (done) {
-      *maintenance = std::monostate{};
+        // TODO: should only apply mouse inputs if the player hand is empty
+        bool done = maintenance_update_minigame(data.maintenance, input, dt);
+        if (done) {
+          data.maintenance = std::monostate{};
+          wake(store, entity.id);
+        }
+      }
     }
-  }
+  });
 }
 
 void system_update_camera(
@@ -733,10 +833,3 @@ void system_update_camera(
   camera.zoom = std::exp(std::log(camera.zoom) + (input.mouse_scroll * 0.05f));
   camera.zoom = std::clamp(camera.zoom, 0.3f, 8.0f);
 }
-
-void system_render(EntityStore& store, EntityId player_id, const AssetManager& assets) {
-  auto* player_entity = get_entity(store, player_id);
-  ASSERT_NO_MSG(player_entity);
-
-  render_entities(store, player_entity->world, assets);
-}
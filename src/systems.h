@@ -4,6 +4,46 @@
 #include "assets.h"
 #include "input.h"
 #include "entity.h"
+#include "jobs.h"
+
+// NOTE: what systems declare they touch, used to figure out which ones can run at the same time
+// the first ENTITY_TYPE_COUNT bits are the data of each entity type
+enum SystemResource : u32 {
+  RESOURCE_TIME = ENTITY_TYPE_COUNT,
+  // NOTE: entity positions, the spatial index and the cached neighbours
+  RESOURCE_SPATIAL,
+  // NOTE: everything wake() touches, the active transport lines included
+  RESOURCE_ACTIVITY,
+  // NOTE: the conveyor graph, its transport lines and the items on them
+  RESOURCE_CONVEYOR_GRAPH,
+  RESOURCE_EVENTS,
+  RESOURCE_COMMANDS,
+  RESOURCE_MESSAGES,
+  RESOURCE_CAMERA,
+
+  RESOURCE_COUNT,
+};
+static_assert(RESOURCE_COUNT <= 64, "ResourceMask only has 64 bits");
+
+template <typename... Ts>
+constexpr ResourceMask entity_resources() {
+  return ((ResourceMask(1) << ENTITY_TYPE<Ts>) | ... | 0);
+}
+
+template <typename... Resources>
+constexpr ResourceMask resources(Resources... values) {
+  return ((ResourceMask(1) << values) | ... | 0);
+}
+
+enum ItemTransferMode {
+  ITEM_TRANSFER_HAND,
+  ITEM_TRANSFER_MACHINE,
+};
+
+// NOTE: returns whether it succeeded in transfering all items from the slot into the inventory
+// also modified the slot to contain the left amount of items after the transfer
+// so if it succeeded slot.count == 0
+bool transfer_items(std::span<ItemSlot> inventory, ItemSlot& slot, ItemTransferMode mode);
 
 void system_update_time(u64& min, f32& min_accumulator, f32 dt);
 void system_move_player(EntityStore& store, EntityId player_id, const Input& input, f32 dt);
@@ -14,6 +54,16 @@ void system_open_gui(
   const vec2& mouse_world_pos
 );
 void system_close_gui(EntityStore& store, EntityId player_id, const Input& input);
+// NOTE: only applies the actions of the gui the player still has open
+void system_apply_gui_actions(
+  EntityStore& store,
+  EntityId player_id,
+  std::span<const GuiAction> actions,
+  ResourceMessageQueue& msg_queue,
+  u64 game_time,
+  u64 random_seed,
+  u64 tick
+);
 void system_hand_slot_interactions(
   EntityStore& store,
   EntityId player_id,
@@ -32,7 +82,9 @@ void system_transfer_resource_messages(
   ResourceMessageQueue& msg_queue,
   u64 game_time
 );
-void system_progress_recipes(EntityStore& store, f32 dt);
+// NOTE: the per world systems only touch entities and transport lines of that one world,
+// so different worlds can run them at the same time
+void system_progress_recipes(EntityStore& store, World world, f32 dt);
 void system_place_entity(
   EntityStore& store,
   EntityId player_id,
@@ -47,10 +99,17 @@ void system_remove_entity(
   const vec2& mouse_world_pos
 );
 void system_pickup_item(EntityStore& store, EntityId player_id);
-void system_output_items(EntityStore& store, f32 dt);
-void system_move_items(EntityStore& store, f32 dt);
+// NOTE: expects update_conveyor_graph() to already have been called this tick
+void system_output_items(EntityStore& store, World world, f32 dt);
+// NOTE: the lines get split into one range per thread, but never into ranges smaller than this,
+// so a handful of lines doesnt get spread over jobs that cost more than moving them
+static constexpr u32 MOVE_ITEMS_MIN_LINES_PER_JOB = 128;
+
+// NOTE: expects update_conveyor_graph() to already have been called this tick
+void system_move_items(EntityStore& store, World world, f32 dt);
 void system_tunnel_through_worlds(EntityStore& store, EntityId player_id);
-void system_apply_maintenance(EntityStore& store);
+// NOTE: every entity rolls on its own stream, so the order they are visited in doesnt matter
+void system_apply_maintenance(EntityStore& store, u64 random_seed, u64 tick);
 void system_update_maintenance_minigames(EntityStore& store, const Input& input, f32 dt);
 void system_update_camera(
   Camera2D& camera,
@@ -59,5 +118,3 @@ void system_update_camera(
   EntityId player_id,
   const vec2& window_dims
 );
-// TODO: remove this, its not really a system (?)
-void system_render(EntityStore& store, EntityId player_id, const AssetManager& assets);
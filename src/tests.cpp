@@ -0,0 +1,865 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json.hpp"
+
+#include "core.h"
+#include "game.h"
+#include "entity.h"
+#include "jobs.h"
+#include "systems.h"
+#include "utils.h"
+#include "serialization.h"
+#include "simulation.h"
+#include "replay.h"
+
+using json = nlohmann::json;
+
+// NOTE: regression tests of the simulation, every test returns whether it passed
+// usage: game_tests [test name], without a name every test runs
+// runs from the root of the repo, so the default map can be found (ctest sets that up)
+
+#define EXPECT(expr, ...)                                                                          \
+  do {                                                                                             \
+    if (!(expr)) {                                                                                 \
+      std::println(                                                                                \
+        stderr,                                                                                    \
+        "Expectation ({}:{}) failed on expression: '{}' with message:",                            \
+        __FILE__,                                                                                  \
+        __LINE__,                                                                                  \
+        #expr                                                                                      \
+      );                                                                                           \
+      std::println(stderr, __VA_ARGS__);                                                           \
+      return false;                                                                                \
+    }                                                                                              \
+  } while (false)
+
+static bool load_default_map(State& state) {
+  if (!std::filesystem::exists(DEFAULT_MAP_FILEPATH)) {
+    std::println(stderr, "world file '{}' doesnt exist", DEFAULT_MAP_FILEPATH);
+    return false;
+  }
+  load_state_from_file(state, DEFAULT_MAP_FILEPATH);
+  flush(state.store);
+  return true;
+}
+
+// NOTE: the conveyor update from before the conveyor graph (see doc.md),
+// every conveyor moves its own items and reads the items of its neighbours from the last tick
+// the items live in the conveyors themselves, so the conveyor graph just stays dirty
+static void reference_output_items(EntityStore& store, World world, f32 dt) {
+  for_each_entity_type([&]<typename T>() {
+    if constexpr (OutputsItems<T>) {
+      for_each_active<T>(store, world, ACTIVITY_OUTPUT, [&](Entity& entity, T& data) {
+        auto first_extractable = [&]() -> ItemSlot* {
+          for (auto& slot : data.inventory) {
+            if (slot && (slot.flags & ITEM_SLOT_MACHINE_OUTPUT)) {
+              return &slot;
+            }
+          }
+          return nullptr;
+        };
+        if (!data.output_neighbours[0] || !first_extractable()) {
+          return false;
+        }
+
+        data.item_output_accumulator += dt;
+        if (data.item_output_accumulator < (1.0f / T::OUTPUT_RATE)) {
+          return true;
+        }
+
+        for (auto output_id : data.output_neighbours) {
+          if (!output_id) {
+            break;
+          }
+          auto* conveyor = get_data<Conveyor>(store, output_id);
+          ASSERT(conveyor, "stale output neighbour");
+
+          auto free_item = std::ranges::find_if(conveyor->items, [](const ConveyorItem& item) {
+            return !item.slot;
+          });
+          auto* slot = first_extractable();
+          if (slot && free_item != conveyor->items.end()) {
+            free_item->slot = {.type = slot->type, .count = 1};
+            if (item_info(slot->type).has_durability) {
+              free_item->slot.damage = slot->damage;
+              slot->damage           = 0;
+            }
+            --slot->count;
+            wake(store, entity.id);
+          }
+        }
+
+        data.item_output_accumulator = 0;
+        return true;
+      });
+    }
+  });
+}
+
+static void reference_move_items(EntityStore& store, World world, f32 dt) {
+  static constexpr f32 ITEM_GAP = 1.0f / CONVEYOR_THROUGHPUT;
+  auto conveyors = view<Conveyor>(store);
+  std::vector<Conveyor> old_conveyors(conveyors.data.begin(), conveyors.data.end());
+  auto old_conveyor = [&](EntityId id) -> const Conveyor* {
+    auto* entity = get_entity(store, id);
+    if (!entity || !is<Conveyor>(*entity)) {
+      return nullptr;
+    }
+    return &old_conveyors[entity - conveyors.entities.data()];
+  };
+
+  for (u32 idx = 0; idx < conveyors.entities.size(); ++idx) {
+    auto& entity = conveyors.entities[idx];
+    if (entity.world != world) {
+      continue;
+    }
+    auto& conveyor = conveyors.data[idx];
+    auto& old      = old_conveyors[idx];
+
+    // NOTE: move items that are already on the conveyor
+    for (u32 i = 0; i < CONVEYOR_THROUGHPUT; ++i) {
+      auto& item = conveyor.items[i];
+      if (item.slot) {
+        if (item.t < 1 - (i * ITEM_GAP)) {
+          item.t += dt;
+        }
+      } else {
+        item.t = 0;
+      }
+    }
+
+    // NOTE: take items on
+    auto* from_entity = get_entity(store, old.from_neighbour);
+    if (auto* old_from = old_conveyor(old.from_neighbour)) {
+      const auto& old_from_item = old_from->items[0];
+      if (conveyor_points_to(*from_entity, entity.pos) && old_from_item.t >= 1.0f) {
+        for (u32 i = 0; i < CONVEYOR_THROUGHPUT; ++i) {
+          if (!old.items[i].slot) {
+            assign_slot(conveyor.items[i].slot, old_from_item.slot);
+            conveyor.items[i].t = 0;
+            break;
+          }
+        }
+      }
+    }
+
+    // NOTE: push items off
+    auto& item      = conveyor.items[0];
+    auto* to_entity = get_entity(store, old.to_neighbour);
+    if (old.items[0].t >= 1.0f && to_entity) {
+      bool success = false;
+      if (auto* old_to = old_conveyor(old.to_neighbour)) {
+        if (conveyor_points_from(*to_entity, entity.pos)) {
+          for (u32 i = 0; i < CONVEYOR_THROUGHPUT; ++i) {
+            if (!old_to->items[i].slot) {
+              assign_slot(item.slot, old_to->items[i].slot);
+              item.t  = 0;
+              success = true;
+              break;
+            }
+          }
+        }
+      } else if (auto to_inv = get_inventory(*to_entity); !to_inv.empty()) {
+        success = transfer_items(to_inv, item.slot, ITEM_TRANSFER_MACHINE);
+        if (success) {
+          wake(store, to_entity->id);
+        }
+      }
+
+      if (success) {
+        std::ranges::rotate(conveyor.items, conveyor.items.begin() + 1);
+      }
+    }
+  }
+}
+
+// NOTE: simulation_tick() with the reference conveyor update, every system runs serially
+static void reference_tick(State& state, f32 dt) {
+  auto& store = state.store;
+  system_apply_gui_actions(
+    store,
+    state.player_id,
+    state.gui_actions,
+    state.resource_message_queue,
+    state.minutes,
+    state.random_seed,
+    state.ticks
+  );
+  system_update_time(state.minutes, state.minutes_accumulator, dt);
+  system_move_player(store, state.player_id, state.tick_input, dt);
+  system_open_gui(store, state.player_id, state.tick_input, state.frame.mouse_world_pos);
+  system_close_gui(store, state.player_id, state.tick_input);
+  system_hand_slot_interactions(
+    store,
+    state.player_id,
+    state.frame.hovered_slot,
+    state.tick_input
+  );
+  system_drop_items(store, state.player_id, state.tick_input, state.frame.mouse_world_pos);
+  system_place_entity(
+    store,
+    state.player_id,
+    state.tick_input,
+    state.frame.mouse_world_pos,
+    state.current_place_rotation
+  );
+  system_remove_entity(store, state.player_id, state.tick_input, state.frame.mouse_world_pos);
+  system_pickup_item(store, state.player_id);
+
+  validate_neighbours(store);
+  for (u32 world = 0; world < WORLD_COUNT; ++world) {
+    reference_output_items(store, World(world), dt);
+    reference_move_items(store, World(world), dt);
+    system_progress_recipes(store, World(world), dt);
+  }
+
+  system_tunnel_through_worlds(store, state.player_id);
+  system_transfer_resource_messages(
+    store,
+    state.resource_message_receiver_id,
+    state.resource_message_queue,
+    state.minutes
+  );
+  system_apply_maintenance(store, state.random_seed, state.ticks);
+  system_update_maintenance_minigames(store, state.tick_input, dt);
+  system_update_camera(
+    state.camera,
+    state.tick_input,
+    store,
+    state.player_id,
+    state.frame.window_dims
+  );
+
+  flush(store);
+  clear_event_bus(store);
+  state.gui_actions.clear();
+  ++state.ticks;
+}
+
+static constexpr u64 TEST_RANDOM_SEED = 0x7465'7374'7365'6565;
+// NOTE: long enough for every finite source of the factory to run dry
+static constexpr u32 FACTORY_TICK_COUNT = 120 * TPS;
+
+static EntityId test_add(State& state, const vec2& pos, World world, const EntityData& data) {
+  return add_entity(state.store, {.pos = pos, .world = world, .data = data});
+}
+
+// NOTE: every step is the direction the conveyor on that tile points to,
+// each one comes from where the one before it was
+static void test_add_conveyors(
+  State& state,
+  vec2 pos,
+  World world,
+  std::initializer_list<Direction> steps,
+  std::optional<ItemType> every_other_item = {}
+) {
+  auto prev = *steps.begin();
+  u32 i     = 0;
+  for (auto step : steps) {
+    Conveyor conveyor{};
+    conveyor.to       = step;
+    conveyor.rotation = opposite_direction(prev);
+    if (every_other_item && i % 2 == 0) {
+      conveyor.items[0] = {.slot = {.type = *every_other_item, .count = 1}, .t = 0.5f};
+    }
+    test_add(state, pos, world, conveyor);
+    pos += direction_to_vec2(step);
+    prev = step;
+    ++i;
+  }
+}
+
+static Storage test_storage(ItemType type, u32 count) {
+  Storage storage{};
+  storage.inventory[0] = {.type = type, .count = count};
+  return storage;
+}
+
+// NOTE: a chain through an assembler with turns, a line that backs up against a block,
+// a loop, two lines merging into one storage and a conveyor pointing into the side of a line,
+// in every world that has room next to the default map
+static void test_add_factory(State& state, const vec2& origin, World world) {
+  test_add(state, origin, world, test_storage(ITEM_ALUMINIUM, 40));
+  test_add_conveyors(
+    state,
+    origin + vec2{1, 0},
+    world,
+    {DIR_RIGHT, DIR_RIGHT, DIR_RIGHT, DIR_RIGHT, DIR_RIGHT, DIR_RIGHT,
+     DIR_DOWN, DIR_DOWN, DIR_RIGHT, DIR_RIGHT, DIR_RIGHT}
+  );
+  // NOTE: the first recipe only needs aluminium
+  test_add(state, origin + vec2{10, 2}, world, Assembler{});
+  test_add_conveyors(
+    state,
+    origin + vec2{11, 2},
+    world,
+    {DIR_RIGHT, DIR_RIGHT, DIR_RIGHT, DIR_UP, DIR_UP, DIR_RIGHT}
+  );
+  test_add(state, origin + vec2{15, 0}, world, Storage{});
+
+  test_add(state, origin + vec2{0, 5}, world, test_storage(ITEM_COPPER, 60));
+  test_add_conveyors(state, origin + vec2{1, 5}, world, {DIR_RIGHT, DIR_RIGHT, DIR_RIGHT, DIR_UP});
+  test_add(state, origin + vec2{4, 4}, world, Block{});
+
+  test_add_conveyors(
+    state,
+    origin + vec2{20, 0},
+    world,
+    {DIR_RIGHT, DIR_RIGHT, DIR_RIGHT, DIR_DOWN, DIR_LEFT, DIR_LEFT, DIR_LEFT, DIR_UP},
+    ITEM_COGWHEEL
+  );
+
+  test_add(state, origin + vec2{26, 0}, world, test_storage(ITEM_ALUMINIUM, 20));
+  test_add_conveyors(
+    state,
+    origin + vec2{27, 0},
+    world,
+    {DIR_RIGHT, DIR_RIGHT, DIR_RIGHT, DIR_DOWN, DIR_DOWN}
+  );
+  // NOTE: a tile longer, so which line gets there first (and into the first slot)
+  // doesnt come down to the order the two are updated in
+  test_add(state, origin + vec2{26, 5}, world, test_storage(ITEM_COPPER, 20));
+  test_add_conveyors(
+    state,
+    origin + vec2{27, 5},
+    world,
+    {DIR_RIGHT, DIR_RIGHT, DIR_RIGHT, DIR_UP, DIR_UP, DIR_UP}
+  );
+  test_add(state, origin + vec2{30, 2}, world, Storage{});
+  // NOTE: conveyors only take items from the one they come from, so this one backs up
+  test_add(state, origin + vec2{28, -2}, world, test_storage(ITEM_COGWHEEL, 20));
+  test_add_conveyors(state, origin + vec2{28, -1}, world, {DIR_DOWN});
+}
+
+static bool load_factory(State& state) {
+  if (!load_default_map(state)) {
+    return false;
+  }
+  state.random_seed = TEST_RANDOM_SEED;
+  for (auto world : {WORLD_MAIN, WORLD_STORAGE}) {
+    test_add_factory(state, {0, 30}, world);
+  }
+  flush(state.store);
+  return true;
+}
+
+// NOTE: the transport lines move items a little further every tick than the conveyors used to
+// (nothing gets lost when an item crosses onto the next conveyor), so they cant be compared tick
+// by tick, but once the sources ran dry every inventory has to end up the same
+// and every conveyor item has to be stuck or looping in the same place
+static bool expect_same_factory(State& state, State& reference) {
+  using ItemCounts = std::array<std::array<u32, ITEM_COUNT>, WORLD_COUNT>;
+  ItemCounts conveyor_items{};
+  ItemCounts reference_conveyor_items{};
+
+  materialize_transport_lines(state.store);
+  for (auto& entity : state.store) {
+    auto* other = get_entity(reference.store, entity.id);
+    EXPECT(other, "entity {} is missing from the reference", u32(entity.id.idx));
+    EXPECT(
+      entity.type == other->type && entity.world == other->world && entity.pos == other->pos,
+      "entity {} moved",
+      u32(entity.id.idx)
+    );
+
+    if (auto* conveyor = get_data<Conveyor>(entity)) {
+      for (auto& item : conveyor->items) {
+        conveyor_items[entity.world][item.slot.type] += item.slot.count;
+      }
+      for (auto& item : get_data<Conveyor>(*other)->items) {
+        reference_conveyor_items[entity.world][item.slot.type] += item.slot.count;
+      }
+      continue;
+    }
+
+    auto inventory           = get_inventory(entity);
+    auto reference_inventory = get_inventory(*other);
+    for (u32 i = 0; i < inventory.size(); ++i) {
+      auto& slot           = inventory[i];
+      auto& reference_slot = reference_inventory[i];
+      EXPECT(
+        slot.count == reference_slot.count &&
+          (!slot || (slot.type == reference_slot.type && slot.damage == reference_slot.damage)),
+        "slot {} of {} {} holds {} {}, the reference {} {}",
+        i,
+        entity_type_to_string(entity.type),
+        u32(entity.id.idx),
+        slot.count,
+        get_item_name(slot.type),
+        reference_slot.count,
+        get_item_name(reference_slot.type)
+      );
+    }
+  }
+  EXPECT(
+    state.store.locations.size() == reference.store.locations.size(),
+    "the reference has more entities"
+  );
+
+  for (u32 world = 0; world < WORLD_COUNT; ++world) {
+    for (u32 type = 0; type < ITEM_COUNT; ++type) {
+      EXPECT(
+        conveyor_items[world][type] == reference_conveyor_items[world][type],
+        "the conveyors of {} hold {} {}, the reference {}",
+        world_to_string(World(world)),
+        conveyor_items[world][type],
+        get_item_name(ItemType(type)),
+        reference_conveyor_items[world][type]
+      );
+    }
+  }
+  return true;
+}
+
+// NOTE: a breakdown stops an assembler until someone fixes it,
+// so it would depend on how far along the assembler was at that tick
+static bool expect_no_maintenance(State& state) {
+  for (auto [entity, assembler] : view<Assembler>(state.store)) {
+    EXPECT(
+      assembler.maintenance.index() == 0,
+      "assembler {} broke down, TEST_RANDOM_SEED has to change",
+      u32(entity.id.idx)
+    );
+  }
+  return true;
+}
+
+static bool test_factory_matches_reference() {
+  State state{};
+  State reference{};
+  if (!load_factory(state) || !load_factory(reference)) {
+    return false;
+  }
+
+  for (u32 tick = 0; tick < FACTORY_TICK_COUNT; ++tick) {
+    simulation_tick(state, DT);
+    reference_tick(reference, DT);
+  }
+
+  return expect_no_maintenance(state) && expect_same_factory(state, reference);
+}
+
+// NOTE: an add or remove of something, with the tick it happens before
+struct TestEdit {
+  u32 tick{};
+  vec2 pos{};
+  std::optional<EntityData> add{};
+};
+
+static Conveyor test_conveyor(Direction to) {
+  Conveyor conveyor{};
+  conveyor.to       = to;
+  conveyor.rotation = opposite_direction(to);
+  return conveyor;
+}
+
+static void test_apply_edit(State& state, const TestEdit& edit, bool full_rebuild) {
+  vec2 pos = vec2{0, 30} + edit.pos;
+  if (full_rebuild) {
+    invalidate_conveyor_graph(state.store);
+  }
+  if (edit.add) {
+    test_add(state, pos, WORLD_MAIN, *edit.add);
+  } else {
+    auto* entity = get_entity_at_pos(state.store, pos, WORLD_MAIN, {1, 1});
+    ASSERT(entity, "nothing to remove at ({}, {})", pos.x, pos.y);
+    remove_entity(state.store, entity->id);
+  }
+  flush(state.store);
+}
+
+// NOTE: placing and removing things only takes apart the transport lines that change,
+// the result has to be the same as rebuilding every line after each change
+static bool test_conveyor_edits_match_rebuild() {
+  static constexpr f32 MAX_T_ERROR = 0.001f;
+  const auto edits = std::to_array<TestEdit>({
+    // NOTE: splits the chain and joins it back together
+    {.tick = 300, .pos = {4, 0}},
+    {.tick = 600, .pos = {4, 0}, .add = test_conveyor(DIR_RIGHT)},
+    // NOTE: opens up the loop and closes it again
+    {.tick = 900, .pos = {22, 0}},
+    {.tick = 1200, .pos = {22, 0}, .add = test_conveyor(DIR_RIGHT)},
+    // NOTE: the line that backed up gets something to hand off into
+    {.tick = 1500, .pos = {4, 4}},
+    {.tick = 1800, .pos = {4, 4}, .add = Storage{}},
+    // NOTE: turns a corner of the chain away from the rest of it and back
+    {.tick = 2100, .pos = {7, 0}},
+    {.tick = 2100, .pos = {7, 0}, .add = test_conveyor(DIR_UP)},
+    {.tick = 2400, .pos = {7, 0}},
+    {.tick = 2400, .pos = {7, 0}, .add = test_conveyor(DIR_DOWN)},
+  });
+
+  State state{};
+  State reference{};
+  if (!load_factory(state) || !load_factory(reference)) {
+    return false;
+  }
+
+  u32 next_edit = 0;
+  for (u32 tick = 0; tick < FACTORY_TICK_COUNT; ++tick) {
+    for (; next_edit < edits.size() && edits[next_edit].tick == tick; ++next_edit) {
+      test_apply_edit(state, edits[next_edit], false);
+      test_apply_edit(reference, edits[next_edit], true);
+    }
+    simulation_tick(state, DT);
+    simulation_tick(reference, DT);
+  }
+
+  materialize_transport_lines(state.store);
+  materialize_transport_lines(reference.store);
+  for (auto [entity, conveyor] : view<Conveyor>(state.store)) {
+    auto* reference_conveyor = get_data<Conveyor>(reference.store, entity.id);
+    EXPECT(reference_conveyor, "conveyor {} is missing from the reference", u32(entity.id.idx));
+    for (u32 i = 0; i < CONVEYOR_THROUGHPUT; ++i) {
+      auto& item           = conveyor.items[i];
+      auto& reference_item = reference_conveyor->items[i];
+      EXPECT(
+        item.slot.count == reference_item.slot.count &&
+          (!item.slot || item.slot.type == reference_item.slot.type) &&
+          std::abs(item.t - reference_item.t) <= MAX_T_ERROR,
+        "item {} of conveyor {} holds {} {} at {}, the reference {} {} at {}",
+        i,
+        u32(entity.id.idx),
+        item.slot.count,
+        get_item_name(item.slot.type),
+        item.t,
+        reference_item.slot.count,
+        get_item_name(reference_item.slot.type),
+        reference_item.t
+      );
+    }
+  }
+  return expect_no_maintenance(state) && expect_same_factory(state, reference);
+}
+
+// NOTE: whatever the head of a line hands off into can change without the line changing
+static bool test_conveyor_target_changes_in_place() {
+  State state{};
+  if (!load_factory(state)) {
+    return false;
+  }
+  // NOTE: by then the line backed up against the block and went to sleep
+  for (u32 tick = 0; tick < FACTORY_TICK_COUNT; ++tick) {
+    simulation_tick(state, DT);
+  }
+
+  auto& graph      = state.store.conveyor_graph;
+  auto* head       = get_entity_at_pos(state.store, {4, 35}, WORLD_MAIN, {1, 1});
+  auto head_idx    = state.store.locations[head->id.idx - 1].idx;
+  auto line_idx    = graph.nodes[head_idx].line_idx;
+  auto target_pos  = vec2{4, 34};
+  auto* block      = get_entity_at_pos(state.store, target_pos, WORLD_MAIN, {1, 1});
+  auto line_target = [&] {
+    return graph.lines[line_idx].target;
+  };
+  EXPECT(line_target() == block->id, "the line doesnt hand off into the block");
+  EXPECT(!graph.lines[line_idx].active, "the line is still awake");
+
+  remove_entity(state.store, block->id);
+  flush(state.store);
+  EXPECT(!line_target(), "the line still hands off into the removed block");
+
+  auto storage_id = test_add(state, target_pos, WORLD_MAIN, Storage{});
+  flush(state.store);
+  EXPECT(line_target() == storage_id, "the line doesnt hand off into the new storage");
+  EXPECT(graph.lines[line_idx].active, "the line didnt wake up for the new storage");
+
+  EXPECT(
+    graph.loose_conveyors.empty() && graph.nodes[head_idx].line_idx == line_idx,
+    "the line got taken apart"
+  );
+  return true;
+}
+
+static constexpr u32 THREADS_TICK_COUNT  = 2000;
+static constexpr u32 THREADS_WORKER_COUNT = 3;
+// NOTE: more than MOVE_ITEMS_MIN_LINES_PER_JOB lines for every thread in every world,
+// so every thread gets a range of lines to move
+static constexpr u32 THREADS_LOOP_COUNT =
+  MOVE_ITEMS_MIN_LINES_PER_JOB * (THREADS_WORKER_COUNT + 1) + 100;
+
+static bool load_threads_factory(State& state) {
+  if (!load_default_map(state)) {
+    return false;
+  }
+  state.random_seed = TEST_RANDOM_SEED;
+  for (auto world : {WORLD_MAIN, WORLD_STORAGE}) {
+    test_add_factory(state, {0, 30}, world);
+  }
+  // NOTE: 2x2 loops below the factory, each one is its own line
+  for (u32 world = 0; world < WORLD_COUNT; ++world) {
+    for (u32 i = 0; i < THREADS_LOOP_COUNT; ++i) {
+      vec2 pos = {f32(i % 50) * 3, 40 + f32(i / 50) * 3};
+      test_add_conveyors(
+        state,
+        pos,
+        World(world),
+        {DIR_RIGHT, DIR_DOWN, DIR_LEFT, DIR_UP},
+        ITEM_COGWHEEL
+      );
+    }
+  }
+  flush(state.store);
+  return true;
+}
+
+// NOTE: the systems and the worlds run on the job system, with workers the result
+// has to be exactly what running everything on the main thread gives
+// also the one to run with GAME_SANITIZE=thread (see CMakeLists.txt)
+static bool test_threads_match_serial() {
+  State serial{};
+  State threaded{};
+  if (!load_threads_factory(serial) || !load_threads_factory(threaded)) {
+    return false;
+  }
+
+  for (u32 tick = 0; tick < THREADS_TICK_COUNT; ++tick) {
+    simulation_tick(serial, DT);
+  }
+  jobs_init(THREADS_WORKER_COUNT);
+  for (u32 tick = 0; tick < THREADS_TICK_COUNT; ++tick) {
+    simulation_tick(threaded, DT);
+  }
+  jobs_shutdown();
+
+  auto serial_saved   = save_state_to_string(serial);
+  auto threaded_saved = save_state_to_string(threaded);
+  EXPECT(
+    serial_saved == threaded_saved,
+    "the run with {} workers diverged from the serial one after {} ticks",
+    THREADS_WORKER_COUNT,
+    THREADS_TICK_COUNT
+  );
+  return true;
+}
+
+static constexpr u32 REPLAY_TICK_COUNT = 2 * TPS;
+
+static std::string read_file(const std::filesystem::path& filepath) {
+  std::ifstream file{filepath, std::ios::binary};
+  return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+static void write_file(const std::filesystem::path& filepath, std::string_view bytes) {
+  std::ofstream file{filepath, std::ios::binary};
+  file.write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+// NOTE: older saves have 16 bit generations, masked into 8 bits 257 would alias generation 1
+static constexpr u32 OLD_GENERATION = ENTITY_ID_GEN_MAX + 2;
+
+static bool test_old_generations_load_as_null() {
+  State original{};
+  if (!load_default_map(original)) {
+    return false;
+  }
+  auto save = json::parse(read_file(DEFAULT_MAP_FILEPATH));
+  auto& entity_id = save.at("store").at("entities").at(0).at("id");
+  auto& free_slot = save.at("store").at("free_slots").at(0);
+  EntityId old_id{.idx = entity_id.at("idx").get<u32>(), .gen = 1};
+  u32 retired_idx = free_slot.at("idx").get<u32>();
+  entity_id["gen"] = OLD_GENERATION;
+  free_slot["gen"] = OLD_GENERATION;
+
+  State state{};
+  load_state_from_string(state, save.dump());
+  flush(state.store);
+
+  EXPECT(!contains_entity(state.store, old_id), "old generation aliases {}", u32(old_id.idx));
+  EXPECT(
+    entity_store_stats(state.store).live == entity_store_stats(original.store).live,
+    "entity with an old generation got lost"
+  );
+  for (auto& id : state.store.free_slots) {
+    EXPECT(id && id.idx != retired_idx, "free slot with an old generation wasnt retired");
+  }
+  return true;
+}
+
+// NOTE: a replay that got cut off or has garbage in its ticks has to be rejected by replay_load(),
+// not abort in the middle of playing it
+static bool test_replay_rejects_corrupt_files() {
+  State state{};
+  if (!load_default_map(state)) {
+    return false;
+  }
+  ReplayRecorder recorder{};
+  replay_record_begin(recorder, state);
+  // NOTE: a bit of everything the recorder stores
+  for (u32 tick = 0; tick < REPLAY_TICK_COUNT; ++tick) {
+    auto& input        = state.tick_input;
+    input.mouse_pos    = {f32(tick), f32(tick / 2)};
+    input.mouse_scroll = i32(tick % 3) - 1;
+    input.lmb          = {.transition_count = u32(tick % 5 == 0), .down = tick % 10 < 5};
+    input.keys[tick % GKEY_COUNT].down = !input.keys[tick % GKEY_COUNT].down;
+    state.frame.mouse_world_pos        = {f32(tick % 20), 5};
+    if (tick % 7 == 0) {
+      state.gui_actions.push_back(
+        {.type   = GuiActionType(tick % GUI_ACTION_TYPE_COUNT),
+         .entity = state.player_id,
+         .idx    = tick}
+      );
+    }
+    replay_record_tick(recorder, state);
+    simulation_tick(state, DT);
+  }
+  auto filepath = std::filesystem::temp_directory_path() / "game_tests_replay.bin";
+  EXPECT(replay_record_end(recorder, state, filepath), "couldnt write the replay");
+
+  Replay replay{};
+  EXPECT(replay_load(replay, filepath), "the replay doesnt load");
+  State played{};
+  replay_begin(replay, played);
+  while (replay_next_tick(replay, played)) {
+    simulation_tick(played, DT);
+  }
+  EXPECT(replay_verify(replay, played), "the replay diverged");
+
+  // NOTE: the ticks are at the end of the file, right after their size
+  auto bytes      = read_file(filepath);
+  u64 ticks_size  = replay.ticks.size();
+  auto header     = std::string_view(bytes).substr(0, bytes.size() - ticks_size - sizeof(u64));
+  auto ticks      = std::string_view(bytes).substr(bytes.size() - ticks_size);
+  auto with_ticks = [&](std::string_view new_ticks) {
+    u64 size = new_ticks.size();
+    std::string file{header};
+    file.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.append(new_ticks);
+    write_file(filepath, file);
+  };
+
+  for (u64 size = 0; size < ticks_size; ++size) {
+    with_ticks(ticks.substr(0, size));
+    EXPECT(!replay_load(replay, filepath), "the replay loads with only {} bytes of ticks", size);
+  }
+  with_ticks(std::string(ticks) + '\0');
+  EXPECT(!replay_load(replay, filepath), "the replay loads with a tick too many");
+  // NOTE: every flag is taken, so the first tick gets replaced by one with a single gui action
+  auto unknown_action = std::string{char(0x80), char(1), char(GUI_ACTION_TYPE_COUNT), 0, 0, 0};
+  with_ticks(unknown_action + std::string(ticks.substr(1)));
+  EXPECT(!replay_load(replay, filepath), "the replay loads with an unknown gui action");
+
+  for (u64 size : {u64(0), u64(6), header.size() / 2, header.size(), bytes.size() - 1}) {
+    write_file(filepath, std::string_view(bytes).substr(0, size));
+    EXPECT(!replay_load(replay, filepath), "the replay loads with only {} bytes", size);
+  }
+
+  std::filesystem::remove(filepath);
+  return true;
+}
+
+struct TestGuiClick {
+  u32 tick{};
+  GuiActionType type{};
+  u32 idx{};
+};
+
+// NOTE: the gui only queues actions for the next tick, so they have to be played back as well
+static bool test_replay_records_gui_actions() {
+  State state{};
+  if (!load_default_map(state)) {
+    return false;
+  }
+  state.random_seed   = TEST_RANDOM_SEED;
+  auto* player_entity = get_entity(state.store, state.player_id);
+  auto sender_id      = test_add(
+    state,
+    player_entity->pos + vec2{1, 0},
+    player_entity->world,
+    ResourceMessageSender{}
+  );
+  flush(state.store);
+  get_data<Player>(state.store, state.player_id)->open_gui = sender_id;
+
+  // NOTE: two messages for different items, then the first one gets cancelled
+  const auto clicks = std::to_array<TestGuiClick>({
+    {10, GUI_ACTION_SWITCH_SENDER_PAGE, SENDER_PAGE_CREATE},
+    {20, GUI_ACTION_ADD_REQUESTED_ITEM, 0},
+    {21, GUI_ACTION_ADD_REQUESTED_ITEM, 0},
+    {30, GUI_ACTION_REMOVE_REQUESTED_ITEM, 0},
+    {40, GUI_ACTION_CREATE_MESSAGE, 0},
+    {50, GUI_ACTION_ADD_REQUESTED_ITEM, 1},
+    {60, GUI_ACTION_CREATE_MESSAGE, 0},
+    {70, GUI_ACTION_CANCEL_MESSAGE, 0},
+  });
+  ReplayRecorder recorder{};
+  replay_record_begin(recorder, state);
+  for (u32 tick = 0; tick < REPLAY_TICK_COUNT; ++tick) {
+    for (auto& click : clicks) {
+      if (click.tick == tick) {
+        state.gui_actions.push_back({.type = click.type, .entity = sender_id, .idx = click.idx});
+      }
+    }
+    replay_record_tick(recorder, state);
+    simulation_tick(state, DT);
+  }
+  auto& msgs = state.resource_message_queue.msgs;
+  EXPECT(msgs.size() == 1, "{} messages got created, instead of 1", msgs.size());
+  EXPECT(
+    msgs[0].requested_items[0] == 0 && msgs[0].requested_items[1] == REQUESTED_ITEMS_MULTIPLE,
+    "the first message didnt get cancelled"
+  );
+
+  auto filepath = std::filesystem::temp_directory_path() / "game_tests_gui_replay.bin";
+  EXPECT(replay_record_end(recorder, state, filepath), "couldnt write the replay");
+  Replay replay{};
+  EXPECT(replay_load(replay, filepath), "the replay doesnt load");
+  std::filesystem::remove(filepath);
+
+  State played{};
+  replay_begin(replay, played);
+  while (replay_next_tick(replay, played)) {
+    simulation_tick(played, DT);
+  }
+  EXPECT(replay_verify(replay, played), "the replay diverged");
+  return true;
+}
+
+struct Test {
+  std::string_view name{};
+  bool (*run)(){};
+};
+
+static constexpr auto TESTS = std::to_array<Test>({
+  {"factory_matches_reference", test_factory_matches_reference},
+  {"conveyor_edits_match_rebuild", test_conveyor_edits_match_rebuild},
+  {"conveyor_target_changes_in_place", test_conveyor_target_changes_in_place},
+  {"threads_match_serial", test_threads_match_serial},
+  {"replay_rejects_corrupt_files", test_replay_rejects_corrupt_files},
+  {"replay_records_gui_actions", test_replay_records_gui_actions},
+  {"old_generations_load_as_null", test_old_generations_load_as_null},
+});
+
+int main(int argc, char** argv) {
+  std::string_view filter = argc > 1 ? argv[1] : "";
+
+  u32 ran    = 0;
+  u32 failed = 0;
+  for (auto& test : TESTS) {
+    if (!filter.empty() && test.name != filter) {
+      continue;
+    }
+    ++ran;
+    bool passed = test.run();
+    failed += !passed;
+    std::println("{} {}", passed ? "passed" : "FAILED", test.name);
+  }
+
+  if (ran == 0) {
+    std::println(stderr, "no test called '{}'", filter);
+    return 1;
+  }
+  std::println("{}/{} tests passed", ran - failed, ran);
+  return failed == 0 ? 0 : 1;
+}
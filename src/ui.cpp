@@ -1,9 +1,20 @@
 #include "ui.h"
 
+#include <algorithm>
+#include <tuple>
+
 #include "utils.h"
+#include "profiler.h"
 
 void ui_system_update(UI_System& system) {
   system.ui_cmds.clear();
+  ++system.frame;
+  system.frame_arena_idx = (system.frame_arena_idx + 1) % system.frame_arenas.size();
+  arena_reset(system.frame_arenas[system.frame_arena_idx]);
+}
+
+static Arena& ui_frame_arena(UI_Layout& layout) {
+  return layout.system->frame_arenas[layout.system->frame_arena_idx];
 }
 
 static bool ui_intersects(const vec2& point, const vec2& start, const vec2& dimensions) {
@@ -84,33 +95,28 @@ static void ui_calculate_fit_fixed_sizing_axis(UI_Layout& layout, UI_ElementIdx
 // the parent has a fit sizing on the same axis
 // and the current layout direction corresponds to that axis (horizontal for x, vertical for y)
 // NOT SURE if that is the 'correct' behaviour but it makes sense to me
-static void ui_calculate_text_fit_fixed_sizing(UI_Layout& layout, UI_ElementIdx idx = 0) {
-  bool has_children = false;
-  auto& elem        = layout.elements[idx];
-  for (UI_ElementIdx child_idx = elem.first_child; child_idx != 0;
-       child_idx               = layout.elements[child_idx].next_sibling) {
-    has_children = true;
-    ui_calculate_text_fit_fixed_sizing(layout, child_idx);
-  }
-
-  switch (elem.config.type) {
-    case UI_ELEMENT_NORMAL: {
-      ui_calculate_fit_fixed_sizing_axis(layout, idx, UI_AXIS_X);
-      ui_calculate_fit_fixed_sizing_axis(layout, idx, UI_AXIS_Y);
-      auto& config = elem.config.normal;
-      if (has_children) {
-        ui_dimension_from_axis(elem, axis_from_layout_direction[config.layout_direction]) -=
-          config.child_gap;
-      }
-    } break;
+static void ui_calculate_text_fit_fixed_sizing(UI_Layout& layout) {
+  // NOTE: backwards, so the children are sized before their parent
+  for (i32 idx = i32(layout.elements.size()) - 1; idx >= 0; --idx) {
+    auto& elem = layout.elements[idx];
+    switch (elem.config.type) {
+      case UI_ELEMENT_NORMAL: {
+        ui_calculate_fit_fixed_sizing_axis(layout, (UI_ElementIdx) idx, UI_AXIS_X);
+        ui_calculate_fit_fixed_sizing_axis(layout, (UI_ElementIdx) idx, UI_AXIS_Y);
+        auto& config = elem.config.normal;
+        if (elem.first_child != 0) {
+          ui_dimension_from_axis(elem, axis_from_layout_direction[config.layout_direction]) -=
+            config.child_gap;
+        }
+      } break;
 
-    case UI_ELEMENT_TEXT: {
-      auto& config    = elem.config.text;
-      auto& str       = layout.strings[config.string_idx];
-      elem.dimensions = vec2_from_raylib(
-        MeasureTextEx(GetFontDefault(), str.c_str(), f32(config.size), TEXT_SPACING)
-      );
-    } break;
+      case UI_ELEMENT_TEXT: {
+        auto& config    = elem.config.text;
+        elem.dimensions = vec2_from_raylib(
+          MeasureTextEx(GetFontDefault(), config.string, f32(config.size), TEXT_SPACING)
+        );
+      } break;
+    }
   }
 }
 
@@ -151,16 +157,14 @@ static void ui_calculate_fill_sizing_axis(UI_Layout& layout, UI_ElementIdx idx,
   }
 }
 
-static void ui_calculate_fill_sizing(UI_Layout& layout, UI_ElementIdx idx = 0) {
-  auto& elem = layout.elements[idx];
-  if (elem.config.type == UI_ELEMENT_TEXT) {
-    return;
-  }
-  ui_calculate_fill_sizing_axis(layout, idx, UI_AXIS_X);
-  ui_calculate_fill_sizing_axis(layout, idx, UI_AXIS_Y);
-  for (UI_ElementIdx child_idx = elem.first_child; child_idx != 0;
-       child_idx               = layout.elements[child_idx].next_sibling) {
-    ui_calculate_fill_sizing(layout, child_idx);
+// NOTE: forwards, a parent sizes its fill children before they size theirs
+static void ui_calculate_fill_sizing(UI_Layout& layout) {
+  for (UI_ElementIdx idx = 0; idx < layout.elements.size(); ++idx) {
+    if (layout.elements[idx].config.type == UI_ELEMENT_TEXT) {
+      continue;
+    }
+    ui_calculate_fill_sizing_axis(layout, idx, UI_AXIS_X);
+    ui_calculate_fill_sizing_axis(layout, idx, UI_AXIS_Y);
   }
 }
 
@@ -272,30 +276,27 @@ ui_adjust_centered_position(UI_Layout& layout, UI_ElementIdx idx, f32 used_space
   }
 }
 
-static void ui_calculate_positions(UI_Layout& layout, UI_ElementIdx idx = 0) {
-  auto& elem = layout.elements[idx];
-  if (idx == 0) {
-    elem.pos = {layout.pos.x, layout.pos.y};
-  }
-  if (elem.config.type == UI_ELEMENT_TEXT) {
-    return;
-  }
-  auto& config   = elem.config.normal;
-  f32 used_space = 0;
-  for (UI_ElementIdx child_idx = elem.first_child; child_idx != 0;
-       child_idx               = layout.elements[child_idx].next_sibling) {
-    auto& child = layout.elements[child_idx];
-    ui_calculate_position_axis(layout, idx, child_idx, used_space, UI_AXIS_X);
-    ui_calculate_position_axis(layout, idx, child_idx, used_space, UI_AXIS_Y);
-    if (config.scroll_value) {
-      child.pos.y += (f32) *config.scroll_value * SCROLL_SENSITIVITY;
+// NOTE: forwards, a parent places its children before they place theirs
+static void ui_calculate_positions(UI_Layout& layout) {
+  layout.elements[0].pos = {layout.pos.x, layout.pos.y};
+  for (UI_ElementIdx idx = 0; idx < layout.elements.size(); ++idx) {
+    auto& elem = layout.elements[idx];
+    if (elem.config.type == UI_ELEMENT_TEXT) {
+      continue;
     }
-  }
-  ui_adjust_centered_position(layout, idx, used_space, UI_AXIS_X);
-  ui_adjust_centered_position(layout, idx, used_space, UI_AXIS_Y);
-  for (UI_ElementIdx child_idx = elem.first_child; child_idx != 0;
-       child_idx               = layout.elements[child_idx].next_sibling) {
-    ui_calculate_positions(layout, child_idx);
+    auto& config   = elem.config.normal;
+    f32 used_space = 0;
+    for (UI_ElementIdx child_idx = elem.first_child; child_idx != 0;
+         child_idx               = layout.elements[child_idx].next_sibling) {
+      auto& child = layout.elements[child_idx];
+      ui_calculate_position_axis(layout, idx, child_idx, used_space, UI_AXIS_X);
+      ui_calculate_position_axis(layout, idx, child_idx, used_space, UI_AXIS_Y);
+      if (config.scroll_value) {
+        child.pos.y += (f32) *config.scroll_value * SCROLL_SENSITIVITY;
+      }
+    }
+    ui_adjust_centered_position(layout, idx, used_space, UI_AXIS_X);
+    ui_adjust_centered_position(layout, idx, used_space, UI_AXIS_Y);
   }
 }
 
@@ -375,18 +376,21 @@ static Rectangle ui_intersection_rectangle(const Rectangle& a, const Rectangle&
   return {};
 }
 
-static void ui_generate_render_cmds(UI_Layout& layout, UI_ElementIdx idx = 0) {
+// NOTE: forwards, so the commands of a parent come before the ones of its children
+static void ui_generate_render_cmds(UI_Layout& layout) {
   // TODO: not sure where to place this line of code
   layout.elements[0].clip_rectangle =
     rect_from_vec2x2(layout.elements[0].pos, layout.elements[0].dimensions);
-  auto& elem = layout.elements[idx];
-  for (UI_ElementIdx child_idx = elem.first_child; child_idx != 0;
-       child_idx               = layout.elements[child_idx].next_sibling) {
+  UI_ElementIdx child_idx = 1;
+  while (child_idx < layout.elements.size()) {
     auto& child = layout.elements[child_idx];
+    auto& elem  = layout.elements[child.parent];
+    // NOTE: nothing in the subtree of an element outside of its parent gets rendered
     if (!ui_intersects(
           rect_from_vec2x2(elem.pos, elem.dimensions),
           rect_from_vec2x2(child.pos, child.dimensions)
         )) {
+      child_idx = child.subtree_end;
       continue;
     }
     child.clip_rectangle =
@@ -395,7 +399,7 @@ static void ui_generate_render_cmds(UI_Layout& layout, UI_ElementIdx idx = 0) {
       case UI_ELEMENT_NORMAL: {
         auto& config = child.config.normal;
         // TODO: this is not really render cmd generation, not sure if it belongs here
-        layout.system->last_frame_data[layout.id].id_map.insert_or_assign(child.id, child_idx);
+        arena_push_back(ui_frame_arena(layout), layout.ids, {.id = child.id, .idx = child_idx});
         if (config.texture) {
           // TODO: this is not really the ideal solution,
           // what if someone really wants to render a fully transparent texture?
@@ -426,42 +430,51 @@ static void ui_generate_render_cmds(UI_Layout& layout, UI_ElementIdx idx = 0) {
       } break;
       case UI_ELEMENT_TEXT: {
         auto& config = child.config.text;
-        auto& str    = layout.strings[config.string_idx];
         layout.system->ui_cmds.push_back(
           UI_TextCommand{
             .pos    = child.pos,
-            .string = str,
+            .string = config.string,
             .size   = config.size,
             .tint   = config.color,
           }
         );
       } break;
     }
-    ui_generate_render_cmds(layout, child_idx);
+    ++child_idx;
   }
 }
 
-// TODO: i hate this, but currently i dont have a clue what could be better
 static void set_first_child_or_next_sibling(UI_Layout& layout) {
-  auto& parent = layout.elements[layout._active_parent];
+  UI_ElementIdx idx = layout.elements.size() - 1;
+  auto& parent      = layout.elements[layout._active_parent];
   if (parent.first_child == 0) {
-    parent.first_child = layout.elements.size() - 1;
+    parent.first_child = idx;
   } else {
-    UI_Element* prev_sibling{};
-    for (UI_ElementIdx idx = parent.first_child; idx != 0;
-         idx               = layout.elements[idx].next_sibling) {
-      prev_sibling = &layout.elements[idx];
-    }
-    prev_sibling->next_sibling = layout.elements.size() - 1;
+    layout.elements[parent.last_child].next_sibling = idx;
   }
+  parent.last_child = idx;
+}
+
+// NOTE: the element with that id in the last frame, if it was rendered in it
+static const UI_Element* ui_last_frame_element(UI_Layout& layout, UI_IdInternal id) {
+  auto it = layout.system->last_frame_data.find(layout.id);
+  if (it == layout.system->last_frame_data.end() || it->second.frame + 1 != layout.system->frame) {
+    return nullptr;
+  }
+  auto& data = it->second;
+  // NOTE: if an id is used more than once the last one wins
+  auto entry = std::ranges::upper_bound(data.ids, id, {}, &UI_IdEntry::id);
+  if (entry == data.ids.begin() || (entry - 1)->id != id) {
+    return nullptr;
+  }
+  return &data.elements[(entry - 1)->idx];
 }
 
 void ui_element_begin(UI_Layout& layout, UI_Id id, const UI_StateOptions& state_options) {
   UI_IdInternal id_internal = id ? std::hash<std::string_view>{}(std::string_view{id})
                                  : std::hash<UI_ElementIdx>{}(layout.elements.size());
-  if (layout.system->last_frame_data[layout.id].id_map.contains(id_internal)) {
-    auto& idx  = layout.system->last_frame_data[layout.id].id_map[id_internal];
-    auto& elem = layout.system->last_frame_data[layout.id].elements[idx];
+  if (auto* last_elem = ui_last_frame_element(layout, id_internal)) {
+    auto& elem = *last_elem;
     Rectangle interaction_rect =
       ui_intersection_rectangle(rect_from_vec2x2(elem.pos, elem.dimensions), elem.clip_rectangle);
     bool hovered = ui_intersects(
@@ -482,11 +495,15 @@ void ui_element_begin(UI_Layout& layout, UI_Id id, const UI_StateOptions& state_
       }
     }
   }
-  layout.elements.push_back({
-    .id     = id_internal,
-    .parent = layout._active_parent,
-    .config = {.type = UI_ELEMENT_NORMAL},
-  });
+  arena_push_back(
+    ui_frame_arena(layout),
+    layout.elements,
+    {
+      .id     = id_internal,
+      .parent = layout._active_parent,
+      .config = {.type = UI_ELEMENT_NORMAL},
+    }
+  );
   set_first_child_or_next_sibling(layout);
   layout._active_parent = layout.elements.size() - 1;
 }
@@ -495,10 +512,8 @@ void ui_element_begin(UI_Layout& layout, UI_Id id, const UI_StateOptions& state_
 vec2 ui_element_get_pos(UI_Layout& layout, UI_Id id) {
   ASSERT(id != UI_AUTO_ID, "have to use a proper element id to get its last position");
   UI_IdInternal id_internal = std::hash<std::string_view>{}(std::string_view{id});
-  if (layout.system->last_frame_data[layout.id].id_map.contains(id_internal)) {
-    auto& idx  = layout.system->last_frame_data[layout.id].id_map[id_internal];
-    auto& elem = layout.system->last_frame_data[layout.id].elements[idx];
-    return elem.pos;
+  if (auto* elem = ui_last_frame_element(layout, id_internal)) {
+    return elem->pos;
   }
   // TODO: do i want to assert here? or maybe return an optional?
   return {};
@@ -514,18 +529,24 @@ void ui_element_end(UI_Layout& layout, const UI_ElementConfigNormal& config) {
   }
   ASSERT(config.corner_radius == 0.0f, "textured thing cannot have corner radius");
   elem.config.normal    = config;
+  elem.subtree_end      = layout.elements.size();
   layout._active_parent = layout.elements[layout._active_parent].parent;
 }
 
 void ui_text(UI_Layout& layout, std::string_view text, f32 size, Color color) {
-  layout.strings.push_back(std::string{text});
-  layout.elements.push_back({
-    .parent = layout._active_parent,
-    .config = {
-      .type = UI_ELEMENT_TEXT,
-      .text = {.string_idx = u32(layout.strings.size() - 1), .size = size, .color = color}
-    },
-  });
+  auto& arena = ui_frame_arena(layout);
+  auto& elem  = arena_push_back(
+    arena,
+    layout.elements,
+    {
+      .parent = layout._active_parent,
+      .config = {
+        .type = UI_ELEMENT_TEXT,
+        .text = {.string = arena_push_string(arena, text), .size = size, .color = color}
+      },
+    }
+  );
+  elem.subtree_end = layout.elements.size();
   set_first_child_or_next_sibling(layout);
 }
 
@@ -558,17 +579,33 @@ void ui_layout_end(UI_Layout& layout) {
        ui_sizing_fixed((u16) layout.max_dimensions.y)
      }}
   );
-  ui_calculate_text_fit_fixed_sizing(layout);
-  ui_calculate_fill_sizing(layout);
-  ui_calculate_positions(layout);
-  ui_handle_scroll(layout);
-  layout.system->last_frame_data[layout.id].id_map.clear();
+  ASSERT(layout.elements[0].subtree_end == layout.elements.size(), "an element wasnt ended");
+  {
+    PROFILE_SCOPE("ui_layout_sizing", PROFILER_ZONE_DETAIL);
+    ui_calculate_text_fit_fixed_sizing(layout);
+    ui_calculate_fill_sizing(layout);
+  }
+  {
+    PROFILE_SCOPE("ui_layout_positions", PROFILER_ZONE_DETAIL);
+    ui_calculate_positions(layout);
+    ui_handle_scroll(layout);
+  }
+  PROFILE_SCOPE("ui_layout_render_cmds", PROFILER_ZONE_DETAIL);
   ui_generate_render_cmds(layout);
-  layout.system->last_frame_data[layout.id].elements = layout.elements;
+  std::ranges::sort(layout.ids, [](const UI_IdEntry& a, const UI_IdEntry& b) {
+    return std::tie(a.id, a.idx) < std::tie(b.id, b.idx);
+  });
+  // NOTE: both stay on the frame arena, which only gets reset the frame after the next one
+  layout.system->last_frame_data[layout.id] = {
+    .frame    = layout.system->frame,
+    .ids      = layout.ids,
+    .elements = layout.elements,
+  };
 }
 
 // NOTE: raylib renderer
 void ui_render(UI_System& system) {
+  PROFILE_SCOPE("ui_render", PROFILER_ZONE_DETAIL);
   for (const auto& cmd : system.ui_cmds) {
     std::visit(
       overloaded{
@@ -611,7 +648,7 @@ void ui_render(UI_System& system) {
         [](const UI_TextCommand& text) {
           DrawTextEx(
             GetFontDefault(),
-            text.string.c_str(),
+            text.string,
             vec2_to_raylib(text.pos),
             text.size,
             TEXT_SPACING,
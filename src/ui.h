@@ -1,11 +1,13 @@
 #pragma once
 
+#include <array>
 #include <variant>
 #include <vector>
 #include <unordered_map>
 
 #include "raylib.h"
 
+#include "arena.h"
 #include "core.h"
 #include "math.h"
 #include "input.h"
@@ -109,7 +111,8 @@ struct UI_ElementConfig {
   union {
     UI_ElementConfigNormal normal{};
     struct {
-      u32 string_idx{};
+      // NOTE: on the frame arena
+      const char* string{};
       f32 size{};
       Color color{};
     } text;
@@ -130,8 +133,11 @@ struct UI_Element {
   UI_ElementIdx parent{};
   // NOTE: if idx == 0 then there is no child
   UI_ElementIdx first_child{};
+  UI_ElementIdx last_child{};
   // NOTE: if idx == 0 then there is no sibling
   UI_ElementIdx next_sibling{};
+  // NOTE: one past the last element of the subtree of this element
+  UI_ElementIdx subtree_end{};
   UI_ElementConfig config{};
   vec2 dimensions{};
   vec2 pos{};
@@ -157,33 +163,51 @@ struct UI_TextureCommand {
 
 struct UI_TextCommand {
   vec2 pos{};
-  std::string string{};
+  // NOTE: on the frame arena
+  const char* string{};
   f32 size{};
   Color tint{};
 };
 
 using UI_Command = std::variant<UI_QuadCommand, UI_TextureCommand, UI_TextCommand>;
 
+struct UI_IdEntry {
+  UI_IdInternal id{};
+  UI_ElementIdx idx{};
+};
+
+// NOTE: all the elements, strings and ids of a frame live on a frame arena,
+// there are two of them, so the ones of the last frame are still there to look up
+// hovers and clicks in, once they are big enough the ui doesnt allocate anymore
 struct UI_System {
   std::vector<UI_Command> ui_cmds{};
+  std::array<Arena, 2> frame_arenas{};
+  u32 frame_arena_idx{};
+  u64 frame{};
   struct LastFrameData {
-    std::unordered_map<UI_IdInternal, UI_ElementIdx> id_map{};
-    std::vector<UI_Element> elements{};
+    // NOTE: the data is only valid if it is from the frame right before this one,
+    // otherwise its arena has already been reset
+    u64 frame{};
+    // NOTE: sorted by id (and idx), so it can be binary searched
+    ArenaArray<UI_IdEntry> ids{};
+    ArenaArray<UI_Element> elements{};
   };
   std::unordered_map<UI_IdInternal, LastFrameData> last_frame_data{};
 };
 
-// NOTE: needs to be called once every frame, before the first ui_begin_layout
+// NOTE: needs to be called once every frame, before the first ui_begin_layout,
+// it resets the frame arena, so the commands of the frame before have to be rendered by then
 void ui_system_update(UI_System& system);
 
 struct UI_Layout {
   UI_IdInternal id{};
   UI_System* system{};
   const Input* input{};
-  // NOTE: weird hack to get the union working, because c++
-  // (should probably switch to a std::variant somewhere to fix this properly)
-  std::vector<std::string> strings{};
-  std::vector<UI_Element> elements{};
+  // NOTE: in pre-order, every element comes before its children and its whole subtree
+  // comes right after it, so the layout passes are just loops over it
+  // (forwards for parents before children, backwards for children before parents)
+  ArenaArray<UI_Element> elements{};
+  ArenaArray<UI_IdEntry> ids{};
   vec2 pos{};
   vec2 max_dimensions{};
 
@@ -1,5 +1,7 @@
 #include "utils.h"
 
+#include <random>
+
 bool operator==(const Color& a, const Color& b) {
   return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
 }
@@ -24,6 +26,11 @@ vec2 dims_from_texture(const Texture2D& texture) {
   return {f32(texture.width), f32(texture.height)};
 }
 
+bool rects_overlap(const Rectangle& a, const Rectangle& b) {
+  return a.x < b.x + b.width && a.x + a.width > b.x && a.y < b.y + b.height &&
+         a.y + a.height > b.y;
+}
+
 // TODO: could possibly do some bit shifting shit, but this seems easier for now
 Direction next_direction(Direction direction) {
   switch (direction) {
@@ -95,8 +102,41 @@ f32 rotation_degrees(Direction rotation) {
   ASSERT(false, "invalid rotation: {}\n", i32(rotation));
 }
 
-// TODO: seed it always in the same way in debug builds?
-std::mt19937 g_random_mt = random_generate();
+u64 random_new_seed() {
+#if MODE_DEBUG
+  return 0x9e3779b97f4a7c15;
+#else
+  std::random_device device{};
+  return (u64(device()) << 32) | device();
+#endif
+}
+
+u64 random_mix(u64 value) {
+  value += 0x9e3779b97f4a7c15;
+  value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+  value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+  return value ^ (value >> 31);
+}
+
+Random random_init(u64 seed, u64 sequence) {
+  Random random{.state = 0, .inc = (sequence << 1) | 1};
+  random_next(random);
+  random.state += seed;
+  random_next(random);
+  return random;
+}
+
+Random random_stream(u64 seed, RandomStream stream, u64 tick, u64 key) {
+  return random_init(random_mix(seed ^ random_mix(tick)), random_mix(u64(stream)) ^ key);
+}
+
+u32 random_next(Random& random) {
+  u64 old        = random.state;
+  random.state   = old * 6364136223846793005 + random.inc;
+  u32 xorshifted = u32(((old >> 18) ^ old) >> 27);
+  u32 rot        = u32(old >> 59);
+  return (xorshifted >> rot) | (xorshifted << ((0u - rot) & 31));
+}
 
 vec2 grid_pos(const vec2& pos) {
   return {std::floor(pos.x / GRID_DIMS.x), std::floor(pos.y / GRID_DIMS.y)};
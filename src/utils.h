@@ -1,7 +1,5 @@
 #pragma once
 
-#include <random>
-
 #include "raylib.h"
 #include "raymath.h"
 
@@ -25,6 +23,8 @@ Vector2 vec2_to_raylib(const vec2& vec);
 vec2 pos_from_rect(const Rectangle& rect);
 vec2 dims_from_rect(const Rectangle& rect);
 vec2 dims_from_texture(const Texture2D& texture);
+// NOTE: same as raylibs CheckCollisionRecs(), which the simulation cant link against
+bool rects_overlap(const Rectangle& a, const Rectangle& b);
 
 enum Direction {
   DIR_UP    = 1 << 0,
@@ -47,20 +47,51 @@ static constexpr vec2 CURSOR_DIMS = {1, 1};
 static constexpr i32 TPS          = 60;
 static constexpr f32 DT           = 1.0f / TPS;
 
-inline std::mt19937 random_generate() {
-  std::random_device rd{};
-  std::seed_seq ss{rd()};
-  return std::mt19937{ss};
-}
+// NOTE: pcg32 (https://www.pcg-random.org/), way smaller and faster than std::mt19937
+// there is no global generator, every user derives its own stream from the seed in the save
+// (see random_stream()), so the numbers dont depend on which thread asks first
+struct Random {
+  u64 state{};
+  u64 inc{};
+};
+
+enum RandomStream : u64 {
+  RANDOM_STREAM_MAINTENANCE,
+  RANDOM_STREAM_MINIGAMES,
+};
 
-extern std::mt19937 g_random_mt;
+// NOTE: a seed for a new world, always the same one in debug builds
+u64 random_new_seed();
+// NOTE: splitmix64, scrambles a value so that close inputs give unrelated outputs
+u64 random_mix(u64 value);
+Random random_init(u64 seed, u64 sequence);
+// NOTE: the numbers of one stream in one tick, for one key (an entity index for example)
+// the same arguments always give the same numbers
+Random random_stream(u64 seed, RandomStream stream, u64 tick, u64 key = 0);
+u32 random_next(Random& random);
 
 template <typename T>
-inline T random_get(T min, T max) {
-  if constexpr (is_any_of<T, u8, u16, u32, u64, i8, i16, i32, i64>) {
-    return std::uniform_int_distribution<T>{min, max}(g_random_mt);
+inline T random_get(Random& random, T min, T max) {
+  if constexpr (is_any_of<T, u8, u16, u32, i8, i16, i32>) {
+    ASSERT_NO_MSG(min <= max);
+    u64 range = u64(i64(max) - i64(min)) + 1;
+    if (range > U32_MAX) {
+      return T(i64(min) + i64(random_next(random)));
+    }
+    // NOTE: lemires multiply and shift, rejecting the few values that would make it biased
+    u32 bound = u32(range);
+    u64 m     = u64(random_next(random)) * bound;
+    if (u32(m) < bound) {
+      u32 threshold = (0u - bound) % bound;
+      while (u32(m) < threshold) {
+        m = u64(random_next(random)) * bound;
+      }
+    }
+    return T(i64(min) + i64(m >> 32));
   } else if constexpr (is_any_of<T, f32, f64>) {
-    return std::uniform_real_distribution<>{min, max}(g_random_mt);
+    // NOTE: 24 bits is all the precision an f32 in [0; 1) has
+    T t = T(random_next(random) >> 8) * T(1.0 / (1 << 24));
+    return min + (t * (max - min));
   } else {
     static_assert(false, "invalid random number type");
   }